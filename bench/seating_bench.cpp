@@ -0,0 +1,222 @@
+// Benchmarks for the seating system. Build from the repository root with
+//     g++ -std=c++17 -O2 -pthread -I. bench/seating_bench.cpp -o seating_bench
+// and run ./seating_bench; results go to standard error, the system's own
+// messages are discarded.
+
+#include "q1.h"
+#include <chrono>
+#include <cstring>
+
+// ============ Helpers ============
+// Swallows everything written to it
+class NullBuffer : public std::streambuf {
+protected:
+    int_type overflow(int_type ch) {
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* /*str*/, std::streamsize n) {
+        return n;
+    }
+};
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Default name of the block at 'index': A to Z, then AA, AB and onward
+static void blockName(int index, char* name) {
+    char reversed[16];
+    int length = 0;
+    for (int n = index + 1; n > 0; n = (n - 1) / 26) reversed[length++] = 'A' + (n - 1) % 26;
+    for (int i = 0; i < length; i++) name[i] = reversed[length - 1 - i];
+    name[length] = '\0';
+}
+
+// Subject id 'subject' gets in the system's table, learned from a capture
+static int subjectIdOf(SeatingSystem& system, const char* subject) {
+    system.insertStudent(1, 22, subject);
+    SessionOverlay probe;
+    system.captureSession(probe);
+    int id = probe.subjectOf(0);
+    system.deleteStudent(1);
+    return id;
+}
+
+// Seat 'perLane' students at the front of both parity lanes of every room,
+// rolls rising in traversal order. With few students per room, every room
+// stays in use and under its minimum occupancy. Returns the students seated.
+static int seatSparsely(SeatingSystem& system, int gridSize, int perLane, int subjectId) {
+    const int rooms = system.countRooms();
+    const int cap = gridSize * gridSize;
+    const int evenLane = (gridSize + 1) / 2 * gridSize;
+    SessionOverlay overlay;
+    overlay.prepare(rooms * cap, rooms * 2 * perLane);
+    int roll = 0;
+    for (int room = 0; room < rooms; room++) {
+        for (int i = 0; i < perLane; i++) overlay.place(room * cap + i, ++roll, 22, subjectId);
+        for (int i = 0; i < perLane; i++) overlay.place(room * cap + evenLane + i, ++roll, 23, subjectId);
+    }
+    system.activateSession(overlay);
+    return roll;
+}
+
+// Rooms holding at least one student, from the free seats of each lane
+static int roomsInUse(SeatingSystem& system, int gridSize) {
+    const int rooms = system.countRooms();
+    int* evenFree = new int[rooms];
+    int* oddFree = new int[rooms];
+    system.capacityFor(22, "Math", evenFree);
+    system.capacityFor(23, "Math", oddFree);
+    int used = 0;
+    for (int i = 0; i < rooms; i++) {
+        if (evenFree[i] < (gridSize + 1) / 2 * gridSize || oddFree[i] < gridSize / 2 * gridSize) used++;
+    }
+    delete[] evenFree;
+    delete[] oddFree;
+    return used;
+}
+
+// Find every seated roll by a scan of the building; the best of 'rounds'
+static double lookupScan(SeatingSystem& system, int students, int rounds) {
+    double best = 0;
+    for (int round = 0; round < rounds; round++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int roll = 1; roll <= students; roll++) system.findStudentByRoll(roll);
+        double ms = elapsedMs(start);
+        if (round == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+// ============ Scan cost before and after collapse ============
+static void benchCollapse() {
+    const int blocks = 8;
+    const int floors = 3;
+    const int roomsPerFloor = 10;
+    const int gridSize = 6;
+    const int rounds = 20;
+
+    SeatingSystem sparse(blocks, floors, roomsPerFloor, gridSize);
+    int students = seatSparsely(sparse, gridSize, 2, subjectIdOf(sparse, "Math"));
+    double before = lookupScan(sparse, students, rounds);
+    std::cerr << "Collapse: " << students << " students spread over " << roomsInUse(sparse, gridSize)
+        << " of " << sparse.countRooms() << " rooms; looking up every roll takes " << before << " ms\n";
+
+    for (int kind = 0; kind < 3; kind++) {
+        SeatingSystem* system = sparse.clone();
+        char name[16];
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int b = 0; b < blocks; b++) {
+            blockName(b, name);
+            if (kind == 2) {
+                system->blockCollapse(name);
+                continue;
+            }
+            for (int f = 1; f <= floors; f++) {
+                if (kind == 1) {
+                    system->floorCollapse(name, f);
+                    continue;
+                }
+                for (int r = 1; r <= roomsPerFloor; r++) system->roomCollapse(name, f, r);
+            }
+        }
+        double collapse = elapsedMs(start);
+        double after = lookupScan(*system, students, rounds);
+        const char* kinds[3] = { "roomCollapse", "floorCollapse", "blockCollapse" };
+        std::cerr << "  " << kinds[kind] << " over the building: " << collapse << " ms, "
+            << roomsInUse(*system, gridSize) << " rooms left in use; lookups then take " << after
+            << " ms (speedup " << (after > 0 ? before / after : 0) << "x), "
+            << system->validateIntegrity(false) << " integrity errors\n";
+        delete system;
+    }
+}
+
+// ============ Campus of 50+ blocks ============
+static void benchCampus() {
+    const int blocks = 60;
+    const int floors = 3;
+    const int roomsPerFloor = 10;
+    const int gridSize = 6;
+    const int students = 20000;
+    const char* subjects[3] = { "Math", "Physics", "Chemistry" };
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    SeatingSystem campus(blocks, floors, roomsPerFloor, gridSize);
+    double build = elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int roll = 1; roll <= students; roll++) campus.insertStudent(roll, 22 + roll % 4, subjects[roll % 3]);
+    double insert = elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int roll = 1; roll <= students; roll += 97) campus.findStudentByRoll(roll);
+    double lookup = elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    char name[16];
+    for (int b = 0; b < blocks; b++) {
+        blockName(b, name);
+        for (int f = 1; f <= floors; f++) {
+            for (int r = 1; r <= roomsPerFloor; r++) campus.findStudentByLocation(name, f, r, 0, 0);
+        }
+    }
+    double locate = elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    int errors = campus.validateIntegrity();
+    double validate = elapsedMs(start);
+
+    std::cerr << "Campus: " << blocks << " blocks, " << campus.countRooms() << " rooms, "
+        << students << " students\n"
+        << "  build " << build << " ms, insert " << insert << " ms, "
+        << (students + 96) / 97 << " roll lookups " << lookup << " ms, "
+        << blocks * floors * roomsPerFloor << " location lookups " << locate << " ms, "
+        << "validate " << validate << " ms, " << errors << " integrity errors\n";
+}
+
+// Every default block name, past Z and ZZ, leads to its block and back:
+// a student seated in each block is found at that block's name, and a
+// lookup by roll reports the same name. Returns the mismatches.
+static int checkBlockNames() {
+    const int blocks = 703;     // A .. Z, AA .. ZZ, AAA
+    const int gridSize = 2;
+    SeatingSystem system(blocks, 1, 1, gridSize);
+    const int cap = gridSize * gridSize;
+    SessionOverlay overlay;
+    overlay.prepare(blocks * cap, blocks);
+    int subjectId = subjectIdOf(system, "Math");
+    for (int b = 0; b < blocks; b++) overlay.place(b * cap, b + 1, 22, subjectId);
+    system.activateSession(overlay);
+
+    int mismatches = 0;
+    char name[16];
+    char expected[32];
+    TextStream report;
+    std::streambuf* previous = std::cout.rdbuf(report.rdbuf());
+    for (int b = 0; b < blocks; b++) {
+        blockName(b, name);
+        Student* student = system.findStudentByLocation(name, 1, 1, 0, 0);
+        report.truncate(0);
+        system.findStudentByRoll(b + 1);
+        std::snprintf(expected, sizeof(expected), "Block %s,", name);
+        if (!student || student->rollNumber != b + 1 || !std::strstr(report.c_str(), expected)) {
+            mismatches++;
+            std::cerr << "  block " << b << " does not round-trip as " << name << "\n";
+        }
+    }
+    std::cout.rdbuf(previous);
+    std::cerr << "Block names: " << blocks << " blocks, A to " << name << ", "
+        << mismatches << " mismatches\n";
+    return mismatches;
+}
+
+int main() {
+    NullBuffer discard;
+    std::streambuf* console = std::cout.rdbuf(&discard);
+    benchCollapse();
+    benchCampus();
+    int mismatches = checkBlockNames();
+    std::cout.rdbuf(console);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -2,34 +2,66 @@
 
 #include <iostream>
 #include <fstream>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SEATING_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SEATING_X86) && defined(__GNUC__)
+#define SEATING_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SEATING_TARGET_AVX2
+#endif
 
 // ============ Custom String Class (No <string> allowed) ============
 class String {
 private:
     char* data;
     int len;
+    int cap;    // bytes allocated for data
 
     void copyFrom(const char* str) {
         if (str) {
             len = 0;
             while (str[len]) len++;
             data = new char[len + 1];
+            cap = len + 1;
             for (int i = 0; i <= len; i++) data[i] = str[i];
         }
         else {
             data = nullptr;
             len = 0;
+            cap = 0;
         }
     }
 
 public:
-    String() : data(nullptr), len(0) {}
+    String() : data(nullptr), len(0), cap(0) {}
 
     String(const char* str) {
         copyFrom(str);
     }
 
-    String(const String& other) : len(other.len) {
+    String(const String& other) : len(other.len), cap(other.data ? other.len + 1 : 0) {
         if (other.data) {
             data = new char[len + 1];
             for (int i = 0; i <= len; i++) data[i] = other.data[i];
@@ -47,6 +79,7 @@ public:
         if (this != &other) {
             delete[] data;
             len = other.len;
+            cap = other.data ? len + 1 : 0;
             if (other.data) {
                 data = new char[len + 1];
                 for (int i = 0; i <= len; i++) data[i] = other.data[i];
@@ -72,6 +105,29 @@ public:
         return len;
     }
 
+    // Add 'n' chars of 'str'; the buffer at least doubles when it grows
+    void append(const char* str, int n) {
+        if (len + n + 1 > cap) {
+            int newCap = cap ? cap * 2 : 64;
+            while (newCap < len + n + 1) newCap *= 2;
+            char* grown = new char[newCap];
+            for (int i = 0; i < len; i++) grown[i] = data[i];
+            delete[] data;
+            data = grown;
+            cap = newCap;
+        }
+        for (int i = 0; i < n; i++) data[len + i] = str[i];
+        len += n;
+        data[len] = '\0';
+    }
+
+    // Keep the first 'n' chars, and the buffer
+    void truncate(int n) {
+        if (n >= len) return;
+        len = n;
+        data[len] = '\0';
+    }
+
     bool operator==(const String& other) const {
         if (len != other.len) return false;
         for (int i = 0; i < len; i++) {
@@ -92,18 +148,445 @@ public:
     }
 };
 
+// ============ Text Stream (an ostream that collects into a String) ============
+// Stands in for std::ostringstream, so text rendered off the calling thread
+// (a block of a report, a message held back for ordering) stays in a String.
+class TextStream : public std::ostream {
+private:
+    class Buffer : public std::streambuf {
+    public:
+        String text;
+
+    protected:
+        int_type overflow(int_type ch) {
+            if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+            char c = traits_type::to_char_type(ch);
+            text.append(&c, 1);
+            return ch;
+        }
+
+        std::streamsize xsputn(const char* str, std::streamsize n) {
+            text.append(str, static_cast<int>(n));
+            return n;
+        }
+    };
+
+    Buffer buffer;
+
+    TextStream(const TextStream&);
+    TextStream& operator=(const TextStream&);
+
+public:
+    TextStream() : std::ostream(nullptr) {
+        rdbuf(&buffer);
+    }
+
+    const char* c_str() const {
+        return buffer.text.c_str();
+    }
+
+    int length() const {
+        return buffer.text.length();
+    }
+
+    // Drop the text after the first 'n' chars
+    void truncate(int n) {
+        buffer.text.truncate(n);
+    }
+
+    // Copy the text to 'out'
+    void writeTo(std::ostream& out) const {
+        out.write(buffer.text.c_str(), buffer.text.length());
+    }
+};
+
+// ============ Subject Table (interns subject names to small ids) ============
+// Each name is allocated once and never moves, so students can point at it.
+class SubjectTable {
+private:
+    String** names;
+    int count;
+    int capacity;
+
+public:
+    SubjectTable() : names(nullptr), count(0), capacity(0) {}
+
+    ~SubjectTable() {
+        for (int i = 0; i < count; i++) delete names[i];
+        delete[] names;
+    }
+
+    // Id of an already-known subject, or -1
+    int find(const char* subject) const {
+        for (int i = 0; i < count; i++) {
+            if (*names[i] == subject) return i;
+        }
+        return -1;
+    }
+
+    int intern(const char* subject) {
+        int id = find(subject);
+        if (id >= 0) return id;
+
+        if (count == capacity) {
+            int newCapacity = capacity ? capacity * 2 : 8;
+            String** grown = new String*[newCapacity];
+            for (int i = 0; i < count; i++) grown[i] = names[i];
+            delete[] names;
+            names = grown;
+            capacity = newCapacity;
+        }
+        names[count] = new String(subject);
+        return count++;
+    }
+
+    const char* name(int id) const {
+        return (id >= 0 && id < count) ? names[id]->c_str() : "";
+    }
+
+    int size() const {
+        return count;
+    }
+
+    // Heap bytes: the name table, the Strings and their buffers
+    long long bytes() const {
+        long long total = static_cast<long long>(capacity) * sizeof(String*);
+        for (int i = 0; i < count; i++) total += sizeof(String) + names[i]->length() + 1;
+        return total;
+    }
+};
+
+// ============ Lane Kernels (SIMD scans over per-room seat lanes) ============
+// A room keeps its seats' rolls, batches and subject ids in parity-ordered
+// lanes: all even columns first, then all odd columns, each column-major.
+// Vacant seats hold the sentinels below.
+const int kVacantRoll = INT_MIN;
+const int kVacantBatch = 0;
+const int kVacantSubject = -1;
+
+inline int countBits(unsigned mask) {
+    int bits = 0;
+    while (mask) {
+        mask &= mask - 1;
+        bits++;
+    }
+    return bits;
+}
+
+inline int lowestBit(unsigned mask) {
+    int bit = 0;
+    while (!(mask & 1u)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+}
+
+// Scalar reference kernels
+inline int countEqualScalar(const int* values, int n, int value) {
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (values[i] == value) count++;
+    }
+    return count;
+}
+
+// Students of 'batch' whose subject differs from 'subject'
+inline int countOtherSubjectScalar(const int* batches, const int* subjects, int n,
+    int batch, int subject) {
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (batches[i] == batch && subjects[i] != subject) count++;
+    }
+    return count;
+}
+
+// First index whose roll exceeds 'roll' (or is vacant, if requested); -1 if none
+inline int findFirstAboveScalar(const int* rolls, int n, int roll, bool stopAtVacant) {
+    for (int i = 0; i < n; i++) {
+        if (rolls[i] > roll) return i;
+        if (stopAtVacant && rolls[i] == kVacantRoll) return i;
+    }
+    return -1;
+}
+
+#if defined(SEATING_X86)
+inline int countEqualSSE2(const int* values, int n, int value) {
+    __m128i key = _mm_set1_epi32(value);
+    int count = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        count += countBits(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key))));
+    }
+    return count + countEqualScalar(values + i, n - i, value);
+}
+
+inline int countOtherSubjectSSE2(const int* batches, const int* subjects, int n,
+    int batch, int subject) {
+    __m128i batchKey = _mm_set1_epi32(batch);
+    __m128i subjectKey = _mm_set1_epi32(subject);
+    int count = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batches + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(subjects + i));
+        __m128i hit = _mm_andnot_si128(_mm_cmpeq_epi32(s, subjectKey), _mm_cmpeq_epi32(b, batchKey));
+        count += countBits(_mm_movemask_ps(_mm_castsi128_ps(hit)));
+    }
+    return count + countOtherSubjectScalar(batches + i, subjects + i, n - i, batch, subject);
+}
+
+inline int findFirstAboveSSE2(const int* rolls, int n, int roll, bool stopAtVacant) {
+    __m128i key = _mm_set1_epi32(roll);
+    __m128i vacant = _mm_set1_epi32(kVacantRoll);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rolls + i));
+        __m128i hit = _mm_cmpgt_epi32(v, key);
+        if (stopAtVacant) hit = _mm_or_si128(hit, _mm_cmpeq_epi32(v, vacant));
+        unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(hit));
+        if (mask) return i + lowestBit(mask);
+    }
+    int tail = findFirstAboveScalar(rolls + i, n - i, roll, stopAtVacant);
+    return tail < 0 ? -1 : i + tail;
+}
+
+SEATING_TARGET_AVX2 inline int countEqualAVX2(const int* values, int n, int value) {
+    __m256i key = _mm256_set1_epi32(value);
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        count += countBits(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, key))));
+    }
+    return count + countEqualSSE2(values + i, n - i, value);
+}
+
+SEATING_TARGET_AVX2 inline int countOtherSubjectAVX2(const int* batches, const int* subjects, int n,
+    int batch, int subject) {
+    __m256i batchKey = _mm256_set1_epi32(batch);
+    __m256i subjectKey = _mm256_set1_epi32(subject);
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(batches + i));
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(subjects + i));
+        __m256i hit = _mm256_andnot_si256(_mm256_cmpeq_epi32(s, subjectKey), _mm256_cmpeq_epi32(b, batchKey));
+        count += countBits(_mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+    }
+    return count + countOtherSubjectSSE2(batches + i, subjects + i, n - i, batch, subject);
+}
+
+SEATING_TARGET_AVX2 inline int findFirstAboveAVX2(const int* rolls, int n, int roll, bool stopAtVacant) {
+    __m256i key = _mm256_set1_epi32(roll);
+    __m256i vacant = _mm256_set1_epi32(kVacantRoll);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rolls + i));
+        __m256i hit = _mm256_cmpgt_epi32(v, key);
+        if (stopAtVacant) hit = _mm256_or_si256(hit, _mm256_cmpeq_epi32(v, vacant));
+        unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+        if (mask) return i + lowestBit(mask);
+    }
+    int tail = findFirstAboveSSE2(rolls + i, n - i, roll, stopAtVacant);
+    return tail < 0 ? -1 : i + tail;
+}
+
+inline bool cpuHasAVX2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuidex(info, 1, 0);
+    bool osSaves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSaves && (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+#endif
+
+struct LaneKernels {
+    const char* name;
+    int (*countEqual)(const int* values, int n, int value);
+    int (*countOtherSubject)(const int* batches, const int* subjects, int n, int batch, int subject);
+    int (*findFirstAbove)(const int* rolls, int n, int roll, bool stopAtVacant);
+};
+
+inline const LaneKernels& scalarLaneKernels() {
+    static const LaneKernels kernels = {
+        "scalar", countEqualScalar, countOtherSubjectScalar, findFirstAboveScalar };
+    return kernels;
+}
+
+// Best kernel set for this CPU, chosen once on first use
+inline const LaneKernels& laneKernels() {
+#if defined(SEATING_X86)
+    static const LaneKernels sse2 = {
+        "sse2", countEqualSSE2, countOtherSubjectSSE2, findFirstAboveSSE2 };
+    static const LaneKernels avx2 = {
+        "avx2", countEqualAVX2, countOtherSubjectAVX2, findFirstAboveAVX2 };
+    static const LaneKernels& selected = cpuHasAVX2() ? avx2 : sse2;
+    return selected;
+#else
+    return scalarLaneKernels();
+#endif
+}
+
+// Check every kernel set this CPU can run against the scalar reference on
+// lanes of each length up to 40, so vector bodies and their scalar tails
+// are both exercised (debug function); returns the number of mismatches
+inline int checkLaneKernels() {
+    LaneKernels sets[2];
+    int setCount = 0;
+#if defined(SEATING_X86)
+    LaneKernels sse2 = { "sse2", countEqualSSE2, countOtherSubjectSSE2, findFirstAboveSSE2 };
+    sets[setCount++] = sse2;
+    if (cpuHasAVX2()) {
+        LaneKernels avx2 = { "avx2", countEqualAVX2, countOtherSubjectAVX2, findFirstAboveAVX2 };
+        sets[setCount++] = avx2;
+    }
+#endif
+    const LaneKernels& scalar = scalarLaneKernels();
+    const int maxLength = 40;
+    int rolls[maxLength];
+    int batches[maxLength];
+    int subjects[maxLength];
+    int mismatches = 0;
+
+    for (int n = 0; n <= maxLength; n++) {
+        // Ascending rolls with vacancies mixed in, two batches, four subjects
+        for (int i = 0; i < n; i++) {
+            bool vacant = (i * 7 + n) % 5 == 0;
+            rolls[i] = vacant ? kVacantRoll : 100 + 3 * i;
+            batches[i] = vacant ? kVacantBatch : 22 + 2 * ((i + n) % 2);
+            subjects[i] = vacant ? kVacantSubject : (i * 3 + n) % 4;
+        }
+        int keys[4] = { 99, 100 + 3 * (n / 2), 101 + 3 * (n / 2), 100 + 3 * n };
+
+        for (int s = 0; s < setCount; s++) {
+            const LaneKernels& kernels = sets[s];
+            bool same = true;
+            for (int k = 0; k < 4; k++) {
+                int batch = 22 + 2 * (k % 2);
+                same = same && kernels.countEqual(batches, n, batch) ==
+                    scalar.countEqual(batches, n, batch);
+                same = same && kernels.countOtherSubject(batches, subjects, n, batch, k) ==
+                    scalar.countOtherSubject(batches, subjects, n, batch, k);
+                for (int stop = 0; stop < 2; stop++) {
+                    same = same && kernels.findFirstAbove(rolls, n, keys[k], stop != 0) ==
+                        scalar.findFirstAbove(rolls, n, keys[k], stop != 0);
+                }
+            }
+            if (!same) {
+                std::cout << "Error: " << kernels.name
+                    << " kernels differ from scalar on lanes of length " << n << "!\n";
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
 // ============ Student Struct ============
 struct Student {
     int rollNumber;
     int batchID;
-    String subject;
+    const char* subject;    // interned name, owned by the system's SubjectTable
+    int subjectId;
+    struct Seat* seat;  // where the student sits; kept by Room::setStudent
 
     Student* next;
 
-    Student() : rollNumber(0), batchID(0), next(nullptr) {}
+    Student() : rollNumber(0), batchID(0), subject(""), subjectId(kVacantSubject), seat(nullptr),
+        next(nullptr) {
+    }
+
+    Student(int roll, int batch, const char* subj, int subjId = kVacantSubject)
+        : rollNumber(roll), batchID(batch), subject(subj ? subj : ""), subjectId(subjId),
+        seat(nullptr), next(nullptr) {
+    }
+};
+
+// ============ Student Pool (chunked storage for student records) ============
+// Students are carved from fixed-size chunks and recycled through a free
+// list threaded on Student::next. reset() takes every record back at once;
+// the chunks stay allocated for the next session.
+class StudentPool {
+private:
+    static const int kChunkSize = 256;
+
+    Student** chunks;
+    int chunkCount;
+    int chunkCapacity;
+    int current;        // chunk being carved
+    int used;           // records taken from it
+    Student* freeList;
+
+    StudentPool(const StudentPool&);
+    StudentPool& operator=(const StudentPool&);
+
+public:
+    StudentPool() : chunks(nullptr), chunkCount(0), chunkCapacity(0), current(0), used(0),
+        freeList(nullptr) {
+    }
+
+    ~StudentPool() {
+        for (int i = 0; i < chunkCount; i++) delete[] chunks[i];
+        delete[] chunks;
+    }
+
+    Student* allocate(int roll, int batch, const char* subject, int subjectId) {
+        Student* student = freeList;
+        if (student) {
+            freeList = student->next;
+        }
+        else {
+            if (used == kChunkSize) {
+                current++;
+                used = 0;
+            }
+            if (current == chunkCount) {
+                if (chunkCount == chunkCapacity) {
+                    int newCapacity = chunkCapacity ? chunkCapacity * 2 : 8;
+                    Student** grown = new Student*[newCapacity];
+                    for (int i = 0; i < chunkCount; i++) grown[i] = chunks[i];
+                    delete[] chunks;
+                    chunks = grown;
+                    chunkCapacity = newCapacity;
+                }
+                chunks[chunkCount++] = new Student[kChunkSize];
+            }
+            student = &chunks[current][used++];
+        }
+        *student = Student(roll, batch, subject, subjectId);
+        return student;
+    }
+
+    void release(Student* student) {
+        student->next = freeList;
+        freeList = student;
+    }
+
+    // Take back every record handed out
+    void reset() {
+        current = 0;
+        used = 0;
+        freeList = nullptr;
+    }
+
+    // Records allocated in chunks, whether in use or free
+    int reserved() const {
+        return chunkCount * kChunkSize;
+    }
 
-    Student(int roll, int batch, const char* subj)
-        : rollNumber(roll), batchID(batch), subject(subj), next(nullptr) {
+    long long bytes() const {
+        return static_cast<long long>(reserved()) * sizeof(Student) +
+            static_cast<long long>(chunkCapacity) * sizeof(Student*);
     }
 };
 
@@ -123,261 +606,1703 @@ struct Seat {
 
     int row;
     int col;
+    int lane;       // index into the owning room's parity lanes
+    int roomIndex;  // owning room's position in traversal order
 
     Seat() : student(nullptr), front(nullptr), back(nullptr),
         left(nullptr), right(nullptr), up(nullptr), down(nullptr),
-        leftBuilding(nullptr), rightBuilding(nullptr), row(0), col(0) {
+        leftBuilding(nullptr), rightBuilding(nullptr), row(0), col(0),
+        lane(0), roomIndex(-1) {
     }
 
     Seat(int r, int c) : student(nullptr), front(nullptr), back(nullptr),
         left(nullptr), right(nullptr), up(nullptr), down(nullptr),
-        leftBuilding(nullptr), rightBuilding(nullptr), row(r), col(c) {
+        leftBuilding(nullptr), rightBuilding(nullptr), row(r), col(c),
+        lane(0), roomIndex(-1) {
     }
 };
 
-// ============ Room Struct ============
-struct Room {
-    int roomNumber;
-    Seat* grid;
-    int gridSize;
-    int occupiedSeats;
+// ============ Work-Stealing Pool (parallel scans over blocks) ============
+// Each participant owns a deque of task indices, works LIFO from its own
+// tail and steals FIFO from the others' heads when it runs dry. The calling
+// thread participates, so a pool with no workers simply runs serially.
+class WorkStealingPool {
+private:
+    struct TaskQueue {
+        std::mutex lock;
+        int* tasks;
+        int head;
+        int tail;
 
-    Room* next;
-    Room* prev;
+        TaskQueue() : tasks(nullptr), head(0), tail(0) {}
 
-    Room() : roomNumber(0), grid(nullptr), gridSize(0),
-        occupiedSeats(0), next(nullptr), prev(nullptr) {
+        ~TaskQueue() {
+            delete[] tasks;
+        }
+    };
+
+    std::thread* workers;
+    int workerCount;
+    TaskQueue* queues;      // one per worker, plus one for the caller
+    int queueCapacity;
+
+    std::mutex jobLock;     // one job at a time
+    std::mutex stateLock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned long generation;
+    int active;             // workers still inside the current job
+    bool stopping;
+
+    void (*jobFn)(void* ctx, int task);
+    void* jobCtx;
+
+    bool popLocal(int q, int& task) {
+        std::lock_guard<std::mutex> lock(queues[q].lock);
+        if (queues[q].tail == queues[q].head) return false;
+        task = queues[q].tasks[--queues[q].tail];
+        return true;
     }
 
-    Room(int roomNo, int size) : roomNumber(roomNo), gridSize(size),
-        occupiedSeats(0), next(nullptr), prev(nullptr) {
-        // Create grid seats
-        Seat* prevRow = nullptr;
-        for (int r = 0; r < gridSize; r++) {
-            Seat* rowStart = nullptr;
-            Seat* prev = nullptr;
-            for (int c = 0; c < gridSize; c++) {
-                Seat* seat = new Seat(r, c);
+    bool steal(int thief, int& task) {
+        for (int k = 1; k <= workerCount; k++) {
+            TaskQueue& victim = queues[(thief + k) % (workerCount + 1)];
+            std::lock_guard<std::mutex> lock(victim.lock);
+            if (victim.tail != victim.head) {
+                task = victim.tasks[victim.head++];
+                return true;
+            }
+        }
+        return false;
+    }
 
-                if (c == 0) rowStart = seat;
-                if (r == 0 && c == 0) grid = seat;
+    void drain(int q) {
+        int task;
+        while (popLocal(q, task) || steal(q, task)) {
+            jobFn(jobCtx, task);
+        }
+    }
 
-                if (prev) {
-                    prev->right = seat;
-                    seat->left = prev;
-                }
+    void workerLoop(int q) {
+        unsigned long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(stateLock);
+                while (!stopping && generation == seen) wake.wait(lock);
+                if (stopping) return;
+                seen = generation;
+            }
 
-                if (prevRow) {
-                    Seat* temp = prevRow;
-                    for (int k = 0; k < c; k++) temp = temp->right;
-                    temp->back = seat;
-                    seat->front = temp;
-                }
+            drain(q);
 
-                prev = seat;
-            }
-            prevRow = rowStart;
+            std::lock_guard<std::mutex> lock(stateLock);
+            if (--active == 0) done.notify_all();
         }
     }
 
-    //~Room() {
-    //    Seat* rowPtr = grid;
-    //    while (rowPtr) {
-    //        Seat* nextRow = rowPtr->back;
-    //        Seat* seat = rowPtr;
-    //        while (seat) {
-    //            Seat* nextSeat = seat->right;
-    //            if (seat->student) delete seat->student;
-    //            delete seat;
-    //            seat = nextSeat;
-    //        }
-    //        rowPtr = nextRow;
-    //    }
-    //}
+    template <class Fn>
+    static void invokeTask(void* ctx, int task) {
+        (*static_cast<Fn*>(ctx))(task);
+    }
 
-    ~Room() {
-        // Return early if the grid was never allocated.
-        if (!grid) {
+    void run(int count, void (*fn)(void* ctx, int task), void* ctx) {
+        // Serial when there is nothing to split or another scan owns the pool
+        std::unique_lock<std::mutex> job(jobLock, std::defer_lock);
+        if (workerCount == 0 || count < 2 || !job.try_lock()) {
+            for (int i = 0; i < count; i++) fn(ctx, i);
             return;
         }
 
-        Seat* rowPtr = grid;
-        // Loop exactly 'gridSize' times to cover each row in this room.
-        for (int r = 0; r < gridSize; ++r) {
-            // It's possible the grid is malformed; break if a row is missing.
-            if (!rowPtr) {
-                break;
+        int participants = workerCount + 1;
+        if (count > queueCapacity) {
+            for (int q = 0; q < participants; q++) {
+                delete[] queues[q].tasks;
+                queues[q].tasks = new int[count];
             }
+            queueCapacity = count;
+        }
+        for (int q = 0; q < participants; q++) {
+            queues[q].head = 0;
+            queues[q].tail = 0;
+        }
+        // Deal tasks round-robin; each queue is drained from its tail, so
+        // push in reverse to start every participant on its lowest index.
+        for (int i = count - 1; i >= 0; i--) {
+            TaskQueue& queue = queues[i % participants];
+            queue.tasks[queue.tail++] = i;
+        }
 
-            // The 'back' pointers are safe because they aren't rewired between rooms.
-            // Save the start of the next row before we start deleting the current one.
-            Seat* nextRow = rowPtr->back;
-
-            Seat* seat = rowPtr;
-            // Loop exactly 'gridSize' times to cover each seat in this row.
-            for (int c = 0; c < gridSize; ++c) {
-                // Break if the row is shorter than expected.
-                if (!seat) {
-                    break;
-                }
+        jobFn = fn;
+        jobCtx = ctx;
+        {
+            std::lock_guard<std::mutex> lock(stateLock);
+            active = workerCount;
+            generation++;
+        }
+        wake.notify_all();
 
-                // Save the next seat's pointer before deleting the current one.
-                Seat* nextSeat = seat->right;
+        drain(workerCount);
 
-                if (seat->student) {
-                    delete seat->student;
-                }
-                delete seat;
+        std::unique_lock<std::mutex> lock(stateLock);
+        while (active > 0) done.wait(lock);
+    }
 
-                seat = nextSeat;
+public:
+    explicit WorkStealingPool(int threads)
+        : workers(nullptr), workerCount(threads > 0 ? threads : 0), queues(nullptr),
+        queueCapacity(0), generation(0), active(0), stopping(false),
+        jobFn(nullptr), jobCtx(nullptr) {
+        queues = new TaskQueue[workerCount + 1];
+        if (workerCount > 0) {
+            workers = new std::thread[workerCount];
+            for (int i = 0; i < workerCount; i++) {
+                workers[i] = std::thread(&WorkStealingPool::workerLoop, this, i);
             }
+        }
+    }
 
-            rowPtr = nextRow;
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(stateLock);
+            stopping = true;
         }
-        // Prevent dangling pointer issues.
-        grid = nullptr;
+        wake.notify_all();
+        for (int i = 0; i < workerCount; i++) workers[i].join();
+        delete[] workers;
+        delete[] queues;
     }
 
-    Seat* getSeat(int row, int col) {
-        if (!grid || row < 0 || row >= gridSize || col < 0 || col >= gridSize) return nullptr;
+    int threads() const {
+        return workerCount + 1;
+    }
 
-        Seat* current = grid;
-        for (int r = 0; r < row; r++) {
-            if (!current) return nullptr;
-            current = current->back;
-        }
-        for (int c = 0; c < col; c++) {
-            if (!current) return nullptr;
-            current = current->right;
-        }
-        return current;
+    // Run fn(i) for every i in [0, count) and wait for all of them
+    template <class Fn>
+    void parallelFor(int count, Fn& fn) {
+        run(count, &invokeTask<Fn>, &fn);
     }
+};
 
-    bool isFull() {
-        return occupiedSeats >= (gridSize * gridSize);
+// Process-wide pool sized to the machine
+inline WorkStealingPool& sharedPool() {
+    static WorkStealingPool pool(std::thread::hardware_concurrency() > 1 ?
+        static_cast<int>(std::thread::hardware_concurrency()) - 1 : 0);
+    return pool;
+}
+
+// ============ SPSC Ring (stages of the roster ingestion pipeline) ============
+// Bounded single-producer, single-consumer queue. Each side writes only its
+// own index and reads the other's, so a push or pop is one acquire load and
+// one release store, without a lock. A full ring holds the producer back:
+// that is the pipeline's backpressure.
+template <class T>
+class SpscRing {
+private:
+    T* slots;
+    unsigned mask;
+    alignas(64) std::atomic<unsigned> head;     // next slot to pop, written by the consumer
+    alignas(64) std::atomic<unsigned> tail;     // next slot to fill, written by the producer
+    alignas(64) std::atomic<bool> closed;
+
+    SpscRing(const SpscRing&);
+    SpscRing& operator=(const SpscRing&);
+
+public:
+    explicit SpscRing(int capacity) : head(0), tail(0), closed(false) {
+        unsigned size = 2;
+        while (size < static_cast<unsigned>(capacity)) size *= 2;
+        slots = new T[size];
+        mask = size - 1;
     }
 
-    int getMinOccupancy() {
-        int total = gridSize * gridSize;
-        return (total + 1) / 2;
+    ~SpscRing() {
+        delete[] slots;
     }
 
-    bool isHalfFull() {
-        return occupiedSeats >= getMinOccupancy();
+    bool tryPush(const T& item) {
+        unsigned t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) return false;
+        slots[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
     }
-};
 
-// ============ Floor Struct ============
-struct Floor {
-    int floorNumber;
-    Room* firstRoom;
-    Room* lastRoom;
-    int totalRooms;
+    // Push, yielding while the ring is full; true if it had to wait
+    bool push(const T& item) {
+        if (tryPush(item)) return false;
+        while (!tryPush(item)) std::this_thread::yield();
+        return true;
+    }
 
-    Floor* next;
-    Floor* prev;
+    bool tryPop(T& item) {
+        unsigned h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
 
-    Floor() : floorNumber(0), firstRoom(nullptr), lastRoom(nullptr),
-        totalRooms(0), next(nullptr), prev(nullptr) {
+    // Pop, yielding while the ring is empty; false once it is closed and
+    // drained. Counts the pops that had to wait in 'waits'.
+    bool pop(T& item, int* waits) {
+        if (tryPop(item)) return true;
+        if (waits) (*waits)++;
+        while (!tryPop(item)) {
+            if (closed.load(std::memory_order_acquire)) return tryPop(item);
+            std::this_thread::yield();
+        }
+        return true;
     }
 
-    Floor(int floorNo, int numRooms, int gridSize)
-        : floorNumber(floorNo), firstRoom(nullptr), lastRoom(nullptr),
-        totalRooms(numRooms), next(nullptr), prev(nullptr) {
+    // The producer is done; pops drain what is left
+    void close() {
+        closed.store(true, std::memory_order_release);
+    }
+};
 
-        Room* prevRoom = nullptr;
-        for (int i = 1; i <= numRooms; i++) {
-            Room* room = new Room(i, gridSize);
+// ============ Grid Traits (compile-time geometry for fixed grid sizes) ============
+// Rooms, floors, blocks and the system are templated on the grid size N.
+// N = kDynamicGrid keeps the size as a runtime field; any other N turns the
+// capacities, lane bounds and minimum occupancy below into constants.
+const int kDynamicGrid = 0;
+
+template <int N>
+struct GridTraits {
+    static const int capacity = N * N;
+    static const int evenLane = N * ((N + 1) / 2);  // seats in even columns
+    static const int oddLane = N * (N / 2);         // seats in odd columns
+    static const int minOccupancy = (N * N + 1) / 2;
+};
 
-            if (!firstRoom) firstRoom = room;
-            if (prevRoom) {
-                prevRoom->next = room;
-                room->prev = prevRoom;
-            }
-            prevRoom = room;
+template <int N> struct BasicFloor;
+template <int N> struct BasicBlock;
+template <int N> class BasicSeatingSystem;
+
+// ============ Occupancy (maintained seat counts of a floor, block or system) ============
+// Counts are kept per batch; a batch only ever sits in one parity lane, so
+// the two lanes never touch the same counter.
+const int kFirstBatch = 22;
+const int kBatchCount = 4;
+
+struct Occupancy {
+    int batchSeats[kBatchCount];    // students of batches 22-25
+    Occupancy* parent;              // floor -> block -> system
+
+    Occupancy() : batchSeats(), parent(nullptr) {}
+
+    // Add 'delta' students of 'batchID' here and at every level above
+    void add(int batchID, int delta) {
+        if (batchID < kFirstBatch || batchID >= kFirstBatch + kBatchCount) return;
+        for (Occupancy* level = this; level; level = level->parent) {
+            level->batchSeats[batchID - kFirstBatch] += delta;
         }
-        lastRoom = prevRoom;
     }
 
-    ~Floor() {
-        Room* current = firstRoom;
-        while (current) {
-            Room* temp = current;
-            current = current->next;
-            delete temp;
-        }
+    int ofBatch(int batchID) const {
+        if (batchID < kFirstBatch || batchID >= kFirstBatch + kBatchCount) return 0;
+        return batchSeats[batchID - kFirstBatch];
+    }
+
+    int total() const {
+        int occupied = 0;
+        for (int i = 0; i < kBatchCount; i++) occupied += batchSeats[i];
+        return occupied;
+    }
+
+    // Zero this level only; the link to the parent stays
+    void clear() {
+        for (int i = 0; i < kBatchCount; i++) batchSeats[i] = 0;
+    }
+
+    // Take 'other's counts for this level only
+    void assign(const Occupancy& other) {
+        for (int i = 0; i < kBatchCount; i++) batchSeats[i] = other.batchSeats[i];
     }
 };
 
-// ============ Block Struct ============
-struct Block {
-    char blockID;
-    Floor* firstFloor;
-    Floor* lastFloor;
-    int totalFloors;
+// ============ Lane Cursor (append position of one parity lane) ============
+// Every seat at or past 'tail' (lane positions counted across rooms in
+// traversal order) is vacant, and no seated roll is above 'maxRoll'. Both
+// only grow as seats are filled, so after deletions they stay safe but loose.
+struct LaneCursor {
+    int tail;
+    int maxRoll;
 
-    Block* next;
-    Block* prev;
+    LaneCursor() : tail(0), maxRoll(kVacantRoll) {}
+};
 
-    Block() : blockID('A'), firstFloor(nullptr), lastFloor(nullptr),
-        totalFloors(0), next(nullptr), prev(nullptr) {
+// ============ Student Index (secondary indexes over seated students) ============
+// Roll-ordered arrays of students. Entries hold the Student itself, which
+// keeps its place in the index when shifts and collapses move it between
+// seats; only placing and deleting a student touch the index.
+class StudentList {
+private:
+    Student** items;
+    int count;
+    int capacity;
+
+    StudentList(const StudentList&);
+    StudentList& operator=(const StudentList&);
+
+public:
+    StudentList() : items(nullptr), count(0), capacity(0) {}
+
+    ~StudentList() {
+        delete[] items;
     }
 
-    Block(char id, int numFloors, int roomsPerFloor, int gridSize)
-        : blockID(id), firstFloor(nullptr), lastFloor(nullptr),
-        totalFloors(numFloors), next(nullptr), prev(nullptr) {
+    int size() const {
+        return count;
+    }
 
-        Floor* prevFloor = nullptr;
-        for (int i = 1; i <= numFloors; i++) {
-            Floor* floor = new Floor(i, roomsPerFloor, gridSize);
+    // Heap bytes of the item array
+    long long bytes() const {
+        return static_cast<long long>(capacity) * sizeof(Student*);
+    }
 
-            if (!firstFloor) firstFloor = floor;
-            if (prevFloor) {
-                prevFloor->next = floor;
-                floor->prev = prevFloor;
-            }
-            prevFloor = floor;
+    void clear() {
+        count = 0;
+    }
+
+    Student* at(int i) const {
+        return items[i];
+    }
+
+    // First position whose roll is not below 'rollNo'
+    int lowerBound(int rollNo) const {
+        int lo = 0;
+        int hi = count;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (items[mid]->rollNumber < rollNo) lo = mid + 1;
+            else hi = mid;
         }
-        lastFloor = prevFloor;
+        return lo;
     }
 
-    ~Block() {
-        Floor* current = firstFloor;
-        while (current) {
-            Floor* temp = current;
-            current = current->next;
-            delete temp;
+    // First position whose roll is above 'rollNo'
+    int upperBound(int rollNo) const {
+        int lo = 0;
+        int hi = count;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (items[mid]->rollNumber <= rollNo) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // Insert after any students with the same roll
+    void insert(Student* student) {
+        if (count == capacity) {
+            int newCapacity = capacity ? capacity * 2 : 16;
+            Student** grown = new Student*[newCapacity];
+            for (int i = 0; i < count; i++) grown[i] = items[i];
+            delete[] items;
+            items = grown;
+            capacity = newCapacity;
+        }
+
+        int pos = upperBound(student->rollNumber);
+        for (int i = count; i > pos; i--) items[i] = items[i - 1];
+        items[pos] = student;
+        count++;
+    }
+
+    void remove(Student* student) {
+        for (int i = lowerBound(student->rollNumber); i < count; i++) {
+            if (items[i]->rollNumber != student->rollNumber) return;
+            if (items[i] == student) {
+                for (int j = i + 1; j < count; j++) items[j - 1] = items[j];
+                count--;
+                return;
+            }
         }
     }
 };
 
-// ============ Seating System Class ============
-class SeatingSystem {
+// Every seated student by parity lane, by batch, and by batch and subject.
+// A batch only ever sits in one parity lane, so the two lanes of
+// applyInLanes update disjoint lists.
+class StudentIndex {
 private:
-    Block* firstBlock;
-    Block* lastBlock;
-    int gridSize;
-    int totalBlocks;
+    StudentList byLane[2];
+    StudentList byBatch[kBatchCount];
+    StudentList** bySubject[kBatchCount];   // per batch, indexed by subject id
+    int subjectSlots[kBatchCount];
 
-    // Helper to find block
-    Block* findBlock(char blockID) {
-        Block* current = firstBlock;
-        while (current) {
-            if (current->blockID == blockID) return current;
-            current = current->next;
+    StudentIndex(const StudentIndex&);
+    StudentIndex& operator=(const StudentIndex&);
+
+    static bool validBatch(int batchID) {
+        return batchID >= kFirstBatch && batchID < kFirstBatch + kBatchCount;
+    }
+
+    StudentList* subjectList(int batchID, int subjectId, bool create) {
+        int b = batchID - kFirstBatch;
+        if (subjectId >= subjectSlots[b]) {
+            if (!create) return nullptr;
+            int slots = subjectSlots[b] ? subjectSlots[b] * 2 : 8;
+            while (slots <= subjectId) slots *= 2;
+            StudentList** grown = new StudentList*[slots];
+            for (int i = 0; i < slots; i++) {
+                grown[i] = i < subjectSlots[b] ? bySubject[b][i] : nullptr;
+            }
+            delete[] bySubject[b];
+            bySubject[b] = grown;
+            subjectSlots[b] = slots;
         }
-        return nullptr;
+        if (!bySubject[b][subjectId] && create) bySubject[b][subjectId] = new StudentList();
+        return bySubject[b][subjectId];
     }
 
-    // Helper to find floor
-    Floor* findFloor(Block* block, int floorNo) {
-        if (!block) return nullptr;
-        Floor* current = block->firstFloor;
-        while (current) {
-            if (current->floorNumber == floorNo) return current;
-            current = current->next;
+public:
+    StudentIndex() : bySubject(), subjectSlots() {}
+
+    ~StudentIndex() {
+        for (int b = 0; b < kBatchCount; b++) {
+            for (int i = 0; i < subjectSlots[b]; i++) delete bySubject[b][i];
+            delete[] bySubject[b];
         }
-        return nullptr;
+    }
+
+    // Forget every student; the storage is kept for reuse
+    void clear() {
+        for (int b = 0; b < kBatchCount; b++) {
+            byBatch[b].clear();
+            for (int i = 0; i < subjectSlots[b]; i++) {
+                if (bySubject[b][i]) bySubject[b][i]->clear();
+            }
+        }
+        byLane[0].clear();
+        byLane[1].clear();
+    }
+
+    void add(Student* student) {
+        if (!validBatch(student->batchID)) return;
+        byLane[student->batchID % 2].insert(student);
+        byBatch[student->batchID - kFirstBatch].insert(student);
+        if (student->subjectId >= 0) subjectList(student->batchID, student->subjectId, true)->insert(student);
+    }
+
+    void remove(Student* student) {
+        if (!validBatch(student->batchID)) return;
+        byLane[student->batchID % 2].remove(student);
+        byBatch[student->batchID - kFirstBatch].remove(student);
+        if (student->subjectId >= 0) {
+            StudentList* list = subjectList(student->batchID, student->subjectId, false);
+            if (list) list->remove(student);
+        }
+    }
+
+    const StudentList& lane(int parity) const {
+        return byLane[parity];
+    }
+
+    // Students of a batch, or nullptr for an unknown batch
+    const StudentList* batch(int batchID) const {
+        return validBatch(batchID) ? &byBatch[batchID - kFirstBatch] : nullptr;
+    }
+
+    // Students of a batch taking a subject, or nullptr if there are none
+    const StudentList* group(int batchID, int subjectId) const {
+        if (!validBatch(batchID) || subjectId < 0) return nullptr;
+        int b = batchID - kFirstBatch;
+        return subjectId < subjectSlots[b] ? bySubject[b][subjectId] : nullptr;
+    }
+
+    // Heap bytes of every list, including the per-subject ones and their slots
+    long long bytes() const {
+        long long total = byLane[0].bytes() + byLane[1].bytes();
+        for (int b = 0; b < kBatchCount; b++) {
+            total += byBatch[b].bytes() +
+                static_cast<long long>(subjectSlots[b]) * sizeof(StudentList*);
+            for (int i = 0; i < subjectSlots[b]; i++) {
+                if (bySubject[b][i]) total += sizeof(StudentList) + bySubject[b][i]->bytes();
+            }
+        }
+        return total;
+    }
+};
+
+// One row of an index query: a student and where they sit
+struct StudentRecord {
+    int rollNumber;
+    int batchID;
+    int subjectId;
+    const char* blockID;    // the block's name, owned by the system
+    int floorNumber;
+    int roomNumber;
+    int row;
+    int col;
+};
+
+// Roll-ordered result of an index query. Owns a copy of the rows, so it
+// stays valid after later mutations of the system.
+class RecordSpan {
+private:
+    StudentRecord* items;
+    int count;
+
+    RecordSpan(const RecordSpan&);
+    RecordSpan& operator=(const RecordSpan&);
+
+public:
+    RecordSpan() : items(nullptr), count(0) {}
+
+    RecordSpan(StudentRecord* rows, int n) : items(rows), count(n) {}
+
+    RecordSpan(RecordSpan&& other) : items(other.items), count(other.count) {
+        other.items = nullptr;
+        other.count = 0;
+    }
+
+    ~RecordSpan() {
+        delete[] items;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    const StudentRecord& operator[](int i) const {
+        return items[i];
+    }
+
+    const StudentRecord* begin() const {
+        return items;
+    }
+
+    const StudentRecord* end() const {
+        return items + count;
+    }
+};
+
+// ============ Seat Journal (write-ahead log of seat changes) ============
+// Every change of a seat's occupant is appended as a fixed-size binary
+// record naming the seat by room index and lane position; a move is a clear
+// of the old seat followed by a place into the new one. A subject's name is
+// written once, before the first record that uses its id. Snapshots use the
+// same format, holding only place records.
+//
+// commit() flushes the stdio buffer and then has the OS write the file to
+// disk (fdatasync, or fsync / _commit where that is missing), so a record
+// that commit() returned for survives a power loss, not just a crash.
+enum JournalKind {
+    JournalPlace = 1,
+    JournalClear = 2,
+    JournalSubject = 3,
+    JournalHeader = 0x324E524A      // first record: room count and room capacity;
+                                    // changes whenever the record layout does
+};
+
+// Fields are fixed at 32 bits, so every batch and subject id of a Student
+// is stored whole and the file reads back on any platform
+struct JournalRecord {
+    std::int32_t kind;
+    std::int32_t seat;      // room index * room capacity + lane position; subject id
+    std::int32_t rollNo;    // subject records: length of the name that follows
+    std::int32_t batchID;
+    std::int32_t subjectId;
+};
+
+class SeatJournal {
+private:
+    std::FILE* file;
+    std::mutex lock;    // the two lanes of applyInLanes append concurrently
+    const SubjectTable* subjects;
+    int subjectsWritten;
+    int records;
+    bool failed;        // a write or sync went wrong
+
+    SeatJournal(const SeatJournal&);
+    SeatJournal& operator=(const SeatJournal&);
+
+    void write(const void* data, std::size_t size) {
+        if (file && std::fwrite(data, 1, size, file) != size) failed = true;
+    }
+
+    void write(const JournalRecord& record) {
+        write(&record, sizeof(record));
+    }
+
+public:
+    // Starts an empty journal for a building of 'roomCount' rooms
+    SeatJournal(const char* path, const SubjectTable* table, int roomCount, int capacity)
+        : file(std::fopen(path, "wb")), subjects(table), subjectsWritten(0), records(0),
+        failed(false) {
+        JournalRecord header = { JournalHeader, roomCount, capacity, 0, 0 };
+        write(header);
+        commit();
+    }
+
+    ~SeatJournal() {
+        if (file) std::fclose(file);
+    }
+
+    bool isOpen() const {
+        return file && !failed;
+    }
+
+    // Records written since the journal was started
+    int size() const {
+        return records;
+    }
+
+    void recordSeat(int seatId, const Student* student) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (student) {
+            while (subjectsWritten <= student->subjectId) {
+                const char* name = subjects->name(subjectsWritten);
+                int length = 0;
+                while (name[length]) length++;
+                JournalRecord subject = { JournalSubject, subjectsWritten, length, 0, 0 };
+                write(subject);
+                write(name, length);
+                subjectsWritten++;
+            }
+            JournalRecord record = { JournalPlace, seatId, student->rollNumber,
+                student->batchID, student->subjectId };
+            write(record);
+        }
+        else {
+            JournalRecord record = { JournalClear, seatId, 0, 0, 0 };
+            write(record);
+        }
+        records++;
+    }
+
+    // Make everything recorded so far durable: flushed, then synced to disk.
+    // False if either step failed.
+    bool commit() {
+        if (!file || failed) return false;
+        if (std::fflush(file) != 0 || !syncToDisk(file)) failed = true;
+        return !failed;
+    }
+
+    static bool syncToDisk(std::FILE* stream) {
+#if defined(_WIN32)
+        return _commit(_fileno(stream)) == 0;
+#elif defined(__linux__)
+        return fdatasync(fileno(stream)) == 0;
+#else
+        return fsync(fileno(stream)) == 0;
+#endif
+    }
+
+    // After a rename: sync the directory holding 'path', so the new name
+    // is on disk too. Nothing to do on Windows.
+    static bool syncDirectoryOf(const char* path) {
+#if defined(_WIN32)
+        (void)path;
+        return true;
+#else
+        int length = 0;
+        int slash = -1;
+        for (; path[length]; length++) {
+            if (path[length] == '/') slash = length;
+        }
+        char* dir = new char[slash > 0 ? slash + 1 : 2];
+        if (slash > 0) {
+            for (int i = 0; i < slash; i++) dir[i] = path[i];
+            dir[slash] = '\0';
+        }
+        else {
+            dir[0] = slash == 0 ? '/' : '.';
+            dir[1] = '\0';
+        }
+        int fd = open(dir, O_RDONLY);
+        delete[] dir;
+        if (fd < 0) return false;
+        bool ok = fsync(fd) == 0;
+        close(fd);
+        return ok;
+#endif
+    }
+
+    // Next record of a journal or snapshot; false at the end or a torn tail
+    static bool read(std::istream& in, JournalRecord& record) {
+        in.read(reinterpret_cast<char*>(&record), sizeof(record));
+        return in.gcount() == static_cast<std::streamsize>(sizeof(record));
+    }
+};
+
+// ============ Undo Log (seat changes of the operation in progress, per lane) ============
+// Records each seat's previous occupant, plus the students that joined and
+// left the indexes, so a failed forward shift or an explicit rollback can
+// restore the building in time proportional to the changes made. Students
+// that leave are only released to 'pool' when the log commits.
+class UndoLog {
+private:
+    struct Entry {
+        Seat* seat;
+        Student* previous;
+    };
+
+    Entry* entries;
+    int count;
+    int capacity;
+    Student** created;
+    int createdCount;
+    int createdCapacity;
+    Student** retired;
+    int retiredCount;
+    int retiredCapacity;
+    bool replaying;     // rolling back; the restores are not logged
+
+    UndoLog(const UndoLog&);
+    UndoLog& operator=(const UndoLog&);
+
+    template <class T>
+    static void reserve(T*& items, int used, int& cap) {
+        if (used < cap) return;
+        int newCapacity = cap ? cap * 2 : 64;
+        T* grown = new T[newCapacity];
+        for (int i = 0; i < used; i++) grown[i] = items[i];
+        delete[] items;
+        items = grown;
+        cap = newCapacity;
+    }
+
+public:
+    struct Mark {
+        int entries;
+        int created;
+        int retired;
+    };
+
+    UndoLog() : entries(nullptr), count(0), capacity(0), created(nullptr), createdCount(0),
+        createdCapacity(0), retired(nullptr), retiredCount(0), retiredCapacity(0),
+        replaying(false) {
+    }
+
+    ~UndoLog() {
+        delete[] entries;
+        delete[] created;
+        delete[] retired;
+    }
+
+    void record(Seat* seat, Student* previous) {
+        if (replaying) return;
+        reserve(entries, count, capacity);
+        entries[count].seat = seat;
+        entries[count].previous = previous;
+        count++;
+    }
+
+    void admitted(Student* student) {
+        reserve(created, createdCount, createdCapacity);
+        created[createdCount++] = student;
+    }
+
+    void retiredStudent(Student* student) {
+        reserve(retired, retiredCount, retiredCapacity);
+        retired[retiredCount++] = student;
+    }
+
+    Mark mark() const {
+        Mark m = { count, createdCount, retiredCount };
+        return m;
+    }
+
+    // Seat changes logged so far
+    int size() const {
+        return count;
+    }
+
+    // Seat of the i-th change, oldest first
+    Seat* seatAt(int i) const {
+        return entries[i].seat;
+    }
+
+    // Append everything 'other' logged after this log's own changes and
+    // empty 'other'; used to fold a block shard's log back in
+    void takeFrom(UndoLog& other) {
+        for (int i = 0; i < other.count; i++) record(other.entries[i].seat, other.entries[i].previous);
+        for (int i = 0; i < other.createdCount; i++) admitted(other.created[i]);
+        for (int i = 0; i < other.retiredCount; i++) retiredStudent(other.retired[i]);
+        other.discard();
+    }
+
+    // Undo everything logged since 'm'. 'restore(seat, student)' puts a
+    // seat's previous occupant back; retired students rejoin 'index' and
+    // students created since the mark leave it and return to 'pool'.
+    template <class Restore>
+    void rollbackTo(const Mark& m, StudentIndex& index, StudentPool& pool, Restore restore) {
+        replaying = true;
+        for (int i = count - 1; i >= m.entries; i--) restore(entries[i].seat, entries[i].previous);
+        replaying = false;
+        count = m.entries;
+
+        for (int i = m.retired; i < retiredCount; i++) index.add(retired[i]);
+        retiredCount = m.retired;
+        for (int i = m.created; i < createdCount; i++) {
+            index.remove(created[i]);
+            pool.release(created[i]);
+        }
+        createdCount = m.created;
+    }
+
+    // Heap bytes of the three logs
+    long long bytes() const {
+        return static_cast<long long>(capacity) * sizeof(Entry) +
+            static_cast<long long>(createdCapacity + retiredCapacity) * sizeof(Student*);
+    }
+
+    // Keep every change; release the students that left
+    void commit(StudentPool& pool) {
+        for (int i = 0; i < retiredCount; i++) pool.release(retired[i]);
+        discard();
+    }
+
+    // Drop the log without touching any student (their pool was reset)
+    void discard() {
+        count = 0;
+        createdCount = 0;
+        retiredCount = 0;
+    }
+};
+
+// ============ Session Overlay (one exam session's occupancy) ============
+// The rooms, seats and links are the same for every session; only who sits
+// where changes. An overlay keeps just that: one int per seat, by global
+// seat id (room index * room capacity + lane position), naming an entry of
+// its compact student table, or -1 for a vacant seat. Subject ids refer to
+// the SubjectTable of the system that captured it.
+class SessionOverlay {
+private:
+    int* seats;
+    int seatCount;
+    int* rolls;
+    int* batches;
+    int* subjectIds;
+    int studentCount;
+
+    SessionOverlay(const SessionOverlay&);
+    SessionOverlay& operator=(const SessionOverlay&);
+
+public:
+    SessionOverlay() : seats(nullptr), seatCount(0), rolls(nullptr), batches(nullptr),
+        subjectIds(nullptr), studentCount(0) {
+    }
+
+    ~SessionOverlay() {
+        clear();
+    }
+
+    void clear() {
+        delete[] seats;
+        delete[] rolls;
+        delete[] batches;
+        delete[] subjectIds;
+        seats = rolls = batches = subjectIds = nullptr;
+        seatCount = studentCount = 0;
+    }
+
+    // Size for 'total' seats and up to 'maxStudents' students, all vacant
+    void prepare(int total, int maxStudents) {
+        clear();
+        seatCount = total;
+        seats = new int[total];
+        for (int i = 0; i < total; i++) seats[i] = -1;
+        rolls = new int[maxStudents > 0 ? maxStudents : 1];
+        batches = new int[maxStudents > 0 ? maxStudents : 1];
+        subjectIds = new int[maxStudents > 0 ? maxStudents : 1];
+    }
+
+    void place(int seatId, int roll, int batch, int subjectId) {
+        rolls[studentCount] = roll;
+        batches[studentCount] = batch;
+        subjectIds[studentCount] = subjectId;
+        seats[seatId] = studentCount++;
+    }
+
+    int size() const {
+        return studentCount;
+    }
+
+    int seatTotal() const {
+        return seatCount;
+    }
+
+    // Student entry at a seat, or -1
+    int studentAt(int seatId) const {
+        return seats[seatId];
+    }
+
+    int rollOf(int student) const {
+        return rolls[student];
+    }
+
+    int batchOf(int student) const {
+        return batches[student];
+    }
+
+    int subjectOf(int student) const {
+        return subjectIds[student];
+    }
+};
+
+// ============ Seat Search (scratch space for nearest-vacancy searches) ============
+// A breadth-first walk over the seat links. Seats and rooms are marked by
+// stamping them with the search's epoch, so the marks are reused from one
+// search to the next without clearing.
+class SeatSearch {
+private:
+    unsigned* seatStamps;
+    int seatCount;
+    unsigned* roomStamps;
+    bool* roomOpen;
+    int roomCount;
+    unsigned epoch;
+    Seat** queue;
+    int* steps;
+    int queueCapacity;
+    int queueLimit;
+    int queued;
+
+    SeatSearch(const SeatSearch&);
+    SeatSearch& operator=(const SeatSearch&);
+
+public:
+    SeatSearch() : seatStamps(nullptr), seatCount(0), roomStamps(nullptr), roomOpen(nullptr),
+        roomCount(0), epoch(0), queue(nullptr), steps(nullptr), queueCapacity(0), queueLimit(0),
+        queued(0) {
+    }
+
+    ~SeatSearch() {
+        delete[] seatStamps;
+        delete[] roomStamps;
+        delete[] roomOpen;
+        delete[] queue;
+        delete[] steps;
+    }
+
+    // Heap bytes of the stamps and the queue
+    long long bytes() const {
+        return static_cast<long long>(seatCount) * sizeof(unsigned) +
+            static_cast<long long>(roomCount) * (sizeof(unsigned) + sizeof(bool)) +
+            static_cast<long long>(queueCapacity) * (sizeof(Seat*) + sizeof(int));
+    }
+
+    // Start a search over 'seats' seats in 'rooms' rooms that queues at
+    // most 'limit' of them
+    void begin(int seats, int rooms, int limit) {
+        if (seats > seatCount || rooms > roomCount) {
+            delete[] seatStamps;
+            delete[] roomStamps;
+            delete[] roomOpen;
+            seatCount = seats;
+            roomCount = rooms;
+            seatStamps = new unsigned[seatCount];
+            roomStamps = new unsigned[roomCount];
+            roomOpen = new bool[roomCount];
+            epoch = 0;
+        }
+        if (++epoch == 1) {
+            // First search, or the epoch wrapped: no stamp may match
+            for (int i = 0; i < seatCount; i++) seatStamps[i] = 0;
+            for (int i = 0; i < roomCount; i++) roomStamps[i] = 0;
+        }
+        if (limit > queueCapacity) {
+            delete[] queue;
+            delete[] steps;
+            queueCapacity = limit;
+            queue = new Seat*[queueCapacity];
+            steps = new int[queueCapacity];
+        }
+        queueLimit = limit;
+        queued = 0;
+    }
+
+    // Queue a seat 'step' links from the start, unless it was queued
+    // already this search or the limit is reached
+    void push(Seat* seat, int seatId, int step) {
+        if (queued == queueLimit || seatStamps[seatId] == epoch) return;
+        seatStamps[seatId] = epoch;
+        queue[queued] = seat;
+        steps[queued] = step;
+        queued++;
+    }
+
+    int size() const {
+        return queued;
+    }
+
+    Seat* at(int i) const {
+        return queue[i];
+    }
+
+    int stepsAt(int i) const {
+        return steps[i];
+    }
+
+    // Subject restriction verdict for a room this search, or -1 if unknown
+    int roomVerdict(int room) const {
+        return roomStamps[room] == epoch ? roomOpen[room] : -1;
+    }
+
+    void setRoomVerdict(int room, bool open) {
+        roomStamps[room] = epoch;
+        roomOpen[room] = open;
+    }
+};
+
+// ============ Room Struct ============
+template <int N>
+struct BasicRoom {
+    typedef BasicRoom<N> Room;
+    typedef BasicFloor<N> Floor;
+
+    int roomNumber;
+    Seat* grid;         // gridSize * gridSize seats, row-major, one allocation
+    int gridSize;
+    int laneOccupied[2];    // students in even / odd columns
+    int index;          // position in building traversal order
+    int* lanes;         // parity lanes: rolls, then batches, then subject ids
+    Floor* floor;
+    SeatJournal* journal;   // receives every seat change while journaling is on
+    bool dirty[2];      // seats changed since the last fixed-layout export, per lane
+    UndoLog* undo;      // the system's two lane logs, indexed by column parity
+    LaneCursor* cursors;    // the system's two lane cursors, indexed by column parity
+    BasicSeatingSystem<N>* owner;
+    int* adjacent;      // per seat (by Seat::lane): same-subject students directly in
+                        // front, behind or beside; null while the adjacency rule is off
+
+    // Copy-on-write sharing between a system and its clones. A clone's room
+    // that has not been written yet reads the seats and lanes of 'origin';
+    // the rooms sharing this one are chained from 'sharers'.
+    Room* origin;
+    Room* sharers;
+    Room* nextSharer;
+    Room* prevSharer;
+
+    Room* next;
+    Room* prev;
+
+    // Fixed-size rooms keep their lanes inline, next to the header
+    int laneStore[N > 0 ? 3 * GridTraits<N>::capacity : 1];
+
+    BasicRoom() : roomNumber(0), grid(nullptr), gridSize(N),
+        laneOccupied(), index(-1), lanes(nullptr), floor(nullptr), journal(nullptr),
+        dirty(), undo(nullptr), cursors(nullptr), owner(nullptr), adjacent(nullptr), origin(nullptr),
+        sharers(nullptr), nextSharer(nullptr), prevSharer(nullptr), next(nullptr), prev(nullptr) {
+    }
+
+    // Rooms built without seats get them from SeatingSystem::clone
+    BasicRoom(int roomNo, int size, bool withSeats = true) : roomNumber(roomNo), grid(nullptr),
+        gridSize(N > 0 ? N : size), laneOccupied(), index(-1), lanes(nullptr), floor(nullptr),
+        journal(nullptr), dirty(), undo(nullptr), cursors(nullptr), owner(nullptr),
+        adjacent(nullptr), origin(nullptr), sharers(nullptr), nextSharer(nullptr), prevSharer(nullptr),
+        next(nullptr), prev(nullptr) {
+        if (withSeats) allocateSeats();
+    }
+
+    ~BasicRoom() {
+        delete[] adjacent;
+
+        // Return early if the grid was never allocated, or is the one of
+        // the room this one still shares.
+        if (!grid || origin) {
+            return;
+        }
+
+        // Students belong to the system's pools, not to the room.
+        delete[] grid;
+        if (lanes != laneStore) delete[] lanes;
+        // Prevent dangling pointer issues.
+        grid = nullptr;
+        lanes = nullptr;
+    }
+
+    // Own, vacant seats and lanes, wired within the room
+    void allocateSeats() {
+        const int total = capacity();
+        const int g = side();
+        grid = new Seat[total];
+        lanes = N > 0 ? laneStore : new int[3 * total];
+        for (int i = 0; i < total; i++) {
+            lanes[i] = kVacantRoll;
+            lanes[total + i] = kVacantBatch;
+            lanes[2 * total + i] = kVacantSubject;
+        }
+
+        // Wire the grid
+        for (int r = 0; r < g; r++) {
+            for (int c = 0; c < g; c++) {
+                Seat* seat = &grid[r * g + c];
+                seat->row = r;
+                seat->col = c;
+                seat->lane = laneOffset(c % 2) + (c / 2) * g + r;
+                seat->roomIndex = index;
+
+                if (c > 0) {
+                    Seat* prev = &grid[r * g + c - 1];
+                    prev->right = seat;
+                    seat->left = prev;
+                }
+                if (r > 0) {
+                    Seat* above = &grid[(r - 1) * g + c];
+                    above->back = seat;
+                    seat->front = above;
+                }
+            }
+        }
+    }
+
+    // Give every clone room still sharing this one its own copy, before
+    // this one changes
+    void releaseSharers() {
+        while (sharers) sharers->owner->unshareRoom(sharers, true);
+    }
+
+    int side() const {
+        return N > 0 ? N : gridSize;
+    }
+
+    int capacity() const {
+        return N > 0 ? GridTraits<N>::capacity : gridSize * gridSize;
+    }
+
+    Seat* getSeat(int row, int col) {
+        const int g = side();
+        if (!grid || row < 0 || row >= g || col < 0 || col >= g) return nullptr;
+        return &grid[row * g + col];
+    }
+
+    // Start of the lane holding even (parity 0) or odd (parity 1) columns
+    int laneOffset(int parity) const {
+        return parity ? laneLength(0) : 0;
+    }
+
+    int laneLength(int parity) const {
+        if (N > 0) return parity ? GridTraits<N>::oddLane : GridTraits<N>::evenLane;
+        return parity ? gridSize * (gridSize / 2) : gridSize * ((gridSize + 1) / 2);
+    }
+
+    const int* laneRolls(int parity) const {
+        return lanes + laneOffset(parity);
+    }
+
+    const int* laneBatches(int parity) const {
+        return lanes + capacity() + laneOffset(parity);
+    }
+
+    const int* laneSubjects(int parity) const {
+        return lanes + 2 * capacity() + laneOffset(parity);
+    }
+
+    // Seat at position 'i' of a parity lane (inverse of Seat::lane)
+    Seat* laneSeat(int parity, int i) {
+        const int g = side();
+        int col = parity + 2 * (i / g);
+        int row = i % g;
+        return &grid[row * g + col];
+    }
+
+    // Seat whose Seat::lane is 'pos'
+    Seat* seatAtLane(int pos) {
+        int even = laneLength(0);
+        return pos < even ? laneSeat(0, pos) : laneSeat(1, pos - even);
+    }
+
+    // Single point through which seats change hands; keeps the lanes and
+    // occupancy counts (here and up through floor, block and system) in step
+    // with the grid. Counts are kept per parity lane so the two lanes can be
+    // filled from different threads.
+    void setStudent(Seat* seat, Student* student) {
+        if (sharers) releaseSharers();
+        if (adjacent) countAdjacent(seat, seat->student, -1);
+        if (undo) undo[seat->col % 2].record(seat, seat->student);
+        if (!seat->student && student) laneOccupied[seat->col % 2]++;
+        else if (seat->student && !student) laneOccupied[seat->col % 2]--;
+        if (floor) {
+            if (seat->student) floor->occupancy.add(seat->student->batchID, -1);
+            if (student) floor->occupancy.add(student->batchID, 1);
+        }
+        if (seat->student && seat->student->seat == seat) seat->student->seat = nullptr;
+        if (student) student->seat = seat;
+        if (student && cursors) {
+            int parity = seat->col % 2;
+            LaneCursor& cursor = cursors[parity];
+            int pos = index * laneLength(parity) + seat->lane - laneOffset(parity);
+            if (pos >= cursor.tail) cursor.tail = pos + 1;
+            if (student->rollNumber > cursor.maxRoll) cursor.maxRoll = student->rollNumber;
+        }
+        seat->student = student;
+        if (adjacent) countAdjacent(seat, student, 1);
+        dirty[seat->col % 2] = true;
+        if (journal) journal->recordSeat(index * capacity() + seat->lane, student);
+
+        const int total = capacity();
+        lanes[seat->lane] = student ? student->rollNumber : kVacantRoll;
+        lanes[total + seat->lane] = student ? student->batchID : kVacantBatch;
+        lanes[2 * total + seat->lane] = student ? student->subjectId : kVacantSubject;
+    }
+
+    // Add 'delta' to the adjacency counts of 'seat', seen as holding
+    // 'student', and of each same-subject neighbour in this room
+    void countAdjacent(Seat* seat, const Student* student, int delta) {
+        if (!student) return;
+        Seat* near[4] = { seat->front, seat->back, seat->left, seat->right };
+        for (int d = 0; d < 4; d++) {
+            Seat* other = near[d];
+            if (!other || other->roomIndex != seat->roomIndex || !other->student) continue;
+            if (other->student->subjectId != student->subjectId) continue;
+            adjacent[other->lane] += delta;
+            adjacent[seat->lane] += delta;
+        }
+    }
+
+    // Turn the adjacency counts on (counted from scratch) or off
+    void trackAdjacency(bool on) {
+        delete[] adjacent;
+        adjacent = nullptr;
+        if (!on) return;
+        const int total = capacity();
+        adjacent = new int[total];
+        for (int i = 0; i < total; i++) adjacent[i] = 0;
+        for (int i = 0; i < total; i++) {
+            Seat* seat = &grid[i];
+            if (!seat->student) continue;
+            Seat* near[2] = { seat->back, seat->right };    // each pair once
+            for (int d = 0; d < 2; d++) {
+                Seat* other = near[d];
+                if (!other || other->roomIndex != seat->roomIndex || !other->student) continue;
+                if (other->student->subjectId != seat->student->subjectId) continue;
+                adjacent[other->lane]++;
+                adjacent[seat->lane]++;
+            }
+        }
+    }
+
+    // Empty every seat at once for SeatingSystem::reset; nothing is logged
+    // or counted upward, and the students are not freed here
+    void vacateAll() {
+        if (sharers) releaseSharers();
+        const int total = capacity();
+        for (int i = 0; i < total; i++) {
+            grid[i].student = nullptr;
+            lanes[i] = kVacantRoll;
+            lanes[total + i] = kVacantBatch;
+            lanes[2 * total + i] = kVacantSubject;
+        }
+        laneOccupied[0] = laneOccupied[1] = 0;
+        dirty[0] = dirty[1] = true;
+        if (adjacent) {
+            for (int i = 0; i < total; i++) adjacent[i] = 0;
+        }
+    }
+
+    int occupiedSeats() const {
+        return laneOccupied[0] + laneOccupied[1];
+    }
+
+    bool isFull() {
+        return occupiedSeats() >= capacity();
+    }
+
+    int getMinOccupancy() {
+        return N > 0 ? GridTraits<N>::minOccupancy : (capacity() + 1) / 2;
+    }
+
+    bool isHalfFull() {
+        return occupiedSeats() >= getMinOccupancy();
+    }
+};
+
+// ============ Floor Struct ============
+template <int N>
+struct BasicFloor {
+    typedef BasicRoom<N> Room;
+    typedef BasicFloor<N> Floor;
+    typedef BasicBlock<N> Block;
+
+    int floorNumber;
+    Room* firstRoom;
+    Room* lastRoom;
+    int totalRooms;
+    Block* block;
+    Occupancy occupancy;
+
+    Floor* next;
+    Floor* prev;
+
+    BasicFloor() : floorNumber(0), firstRoom(nullptr), lastRoom(nullptr),
+        totalRooms(0), block(nullptr), next(nullptr), prev(nullptr) {
+    }
+
+    BasicFloor(int floorNo, int numRooms, int gridSize, bool withSeats = true)
+        : floorNumber(floorNo), firstRoom(nullptr), lastRoom(nullptr),
+        totalRooms(numRooms), block(nullptr), next(nullptr), prev(nullptr) {
+
+        Room* prevRoom = nullptr;
+        for (int i = 1; i <= numRooms; i++) {
+            Room* room = new Room(i, gridSize, withSeats);
+            room->floor = this;
+
+            if (!firstRoom) firstRoom = room;
+            if (prevRoom) {
+                prevRoom->next = room;
+                room->prev = prevRoom;
+            }
+            prevRoom = room;
+        }
+        lastRoom = prevRoom;
+    }
+
+    int occupiedSeats() const {
+        return occupancy.total();
+    }
+
+    int capacity() const {
+        return firstRoom ? totalRooms * firstRoom->capacity() : 0;
+    }
+
+    int getMinOccupancy() const {
+        return (capacity() + 1) / 2;
+    }
+
+    ~BasicFloor() {
+        Room* current = firstRoom;
+        while (current) {
+            Room* temp = current;
+            current = current->next;
+            delete temp;
+        }
+    }
+};
+
+// ============ Block Struct ============
+template <int N>
+struct BasicBlock {
+    typedef BasicFloor<N> Floor;
+    typedef BasicBlock<N> Block;
+
+    String blockID;     // "A", "AB", "101", ...
+    Floor* firstFloor;
+    Floor* lastFloor;
+    int totalFloors;
+    Occupancy occupancy;
+
+    Block* next;
+    Block* prev;
+
+    BasicBlock() : blockID("A"), firstFloor(nullptr), lastFloor(nullptr),
+        totalFloors(0), next(nullptr), prev(nullptr) {
+    }
+
+    BasicBlock(const char* id, int numFloors, int roomsPerFloor, int gridSize, bool withSeats = true)
+        : blockID(id), firstFloor(nullptr), lastFloor(nullptr),
+        totalFloors(numFloors), next(nullptr), prev(nullptr) {
+
+        Floor* prevFloor = nullptr;
+        for (int i = 1; i <= numFloors; i++) {
+            Floor* floor = new Floor(i, roomsPerFloor, gridSize, withSeats);
+            floor->block = this;
+            floor->occupancy.parent = &occupancy;
+
+            if (!firstFloor) firstFloor = floor;
+            if (prevFloor) {
+                prevFloor->next = floor;
+                floor->prev = prevFloor;
+            }
+            prevFloor = floor;
+        }
+        lastFloor = prevFloor;
+    }
+
+    int occupiedSeats() const {
+        return occupancy.total();
+    }
+
+    int capacity() const {
+        return firstFloor ? totalFloors * firstFloor->capacity() : 0;
+    }
+
+    int getMinOccupancy() const {
+        return (capacity() + 1) / 2;
+    }
+
+    ~BasicBlock() {
+        Floor* current = firstFloor;
+        while (current) {
+            Floor* temp = current;
+            current = current->next;
+            delete temp;
+        }
+    }
+};
+
+// ============ Roster Ingestion (reader and parser stages of loadFromFile) ============
+// A block of the roster file as read; the parser frees it
+struct RosterChunk {
+    char* data;
+    int size;
+};
+
+// One parsed roster line. Subject ids are the parser's own; the first
+// record of each subject carries its name in 'newSubject', which the
+// consumer frees.
+struct RosterRecord {
+    int rollNo;
+    int batchID;
+    int subjectId;
+    char* newSubject;
+};
+
+// Splits roster text ("batch roll subject", whitespace separated) into
+// records a chunk at a time; a field may straddle two chunks. Parsing stops
+// at the first field that is not a number where one is expected.
+class RosterParser {
+private:
+    SubjectTable subjects;
+    char token[100];    // subject names are cut at 99 characters
+    int tokenLength;
+    int field;          // 0 batch, 1 roll, 2 subject
+    RosterRecord pending;
+    bool stopped;
+
+    bool parseInt(int& value) const {
+        int i = (token[0] == '-' || token[0] == '+') ? 1 : 0;
+        if (i == tokenLength) return false;
+        long long result = 0;
+        for (; i < tokenLength; i++) {
+            if (token[i] < '0' || token[i] > '9') return false;
+            result = result * 10 + (token[i] - '0');
+            if (result > INT_MAX) return false;
+        }
+        value = static_cast<int>(token[0] == '-' ? -result : result);
+        return true;
+    }
+
+    template <class Emit>
+    void endToken(Emit& emit) {
+        if (tokenLength == 0) return;
+        token[tokenLength] = '\0';
+        if (field == 0) stopped = !parseInt(pending.batchID);
+        else if (field == 1) stopped = !parseInt(pending.rollNo);
+        else {
+            pending.subjectId = subjects.find(token);
+            pending.newSubject = nullptr;
+            if (pending.subjectId < 0) {
+                pending.subjectId = subjects.intern(token);
+                pending.newSubject = new char[tokenLength + 1];
+                for (int i = 0; i <= tokenLength; i++) pending.newSubject[i] = token[i];
+            }
+            emit(pending);
+        }
+        field = (field + 1) % 3;
+        tokenLength = 0;
+    }
+
+public:
+    RosterParser() : tokenLength(0), field(0), pending(), stopped(false) {}
+
+    // Parse the next chunk, passing each complete record to 'emit'
+    template <class Emit>
+    void feed(const char* data, int size, Emit& emit) {
+        for (int i = 0; i < size && !stopped; i++) {
+            char c = data[i];
+            if (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f') {
+                endToken(emit);
+            }
+            else if (tokenLength < 99) {
+                token[tokenLength++] = c;
+            }
+        }
+    }
+
+    // End of input: the last field may lack trailing whitespace
+    template <class Emit>
+    void finish(Emit& emit) {
+        if (!stopped) endToken(emit);
+    }
+
+    bool malformed() const {
+        return stopped;
+    }
+};
+
+// ============ Lane Operation (input to SeatingSystem::applyInLanes) ============
+struct LaneOp {
+    enum Kind { Insert, Delete };
+
+    Kind kind;
+    int rollNo;
+    int batchID;            // inserts only
+    const char* subject;    // inserts only
+
+    static LaneOp insert(int roll, int batch, const char* subj) {
+        LaneOp op = { Insert, roll, batch, subj };
+        return op;
+    }
+
+    static LaneOp remove(int roll) {
+        LaneOp op = { Delete, roll, 0, nullptr };
+        return op;
+    }
+};
+
+// ============ Footprint (memory held by a SeatingSystem) ============
+// Bytes and object counts per kind of storage, as reported by
+// SeatingSystem::footprint. Bytes are what the system asked for; allocator
+// overhead and the journal's file buffer are not included.
+struct Footprint {
+    enum Part { Seats, Rooms, Floors, Blocks, Students, Subjects, Indexes, Other, PartCount };
+
+    long long objects[PartCount];
+    long long bytes[PartCount];
+
+    Footprint() : objects(), bytes() {}
+
+    void add(Part part, long long count, long long size) {
+        objects[part] += count;
+        bytes[part] += size;
+    }
+
+    long long totalBytes() const {
+        long long total = 0;
+        for (int i = 0; i < PartCount; i++) total += bytes[i];
+        return total;
+    }
+
+    static const char* name(int part) {
+        static const char* const names[PartCount] = { "Seats", "Room headers and lanes",
+            "Floor headers", "Block headers", "Student records", "Subject names", "Indexes",
+            "Logs and scratch" };
+        return names[part];
+    }
+};
+
+// ============ Seating System Class ============
+template <int N>
+class BasicSeatingSystem {
+public:
+    typedef BasicRoom<N> Room;
+    typedef BasicFloor<N> Floor;
+    typedef BasicBlock<N> Block;
+
+private:
+    friend struct BasicRoom<N>;     // Room::releaseSharers hands out copies
+
+    Block* firstBlock;
+    Block* lastBlock;
+    int gridSize;
+    int totalBlocks;
+
+    Block** blocks;     // every block, in traversal order
+    Room** rooms;       // every room, in traversal order
+    int roomCount;
+    SubjectTable subjects;
+    Occupancy occupancy;    // whole building; blocks report into it
+    StudentIndex students;  // batch, subject and roll-range queries
+    UndoLog undo[2];        // changes of the operation in progress, per lane
+    StudentPool pools[2];   // student records, by batch parity
+    LaneCursor cursors[2];  // append fast path of findInsertionPosition, per lane
+    bool inTransaction;     // beginTransaction holds the write lock until commit/rollback
+    bool adjacencyRule;     // no two students of a subject directly in front, behind or beside
+    std::atomic<int> sharedRooms;   // rooms of this clone still sharing their source's seats
+    std::atomic<int> sharedOut;     // clone rooms sharing this system's seats
+
+    // Write-ahead journal; null while journaling is off
+    SeatJournal* journal;
+    String journalPath;
+    String snapshotPath;
+    int checkpointEvery;    // journal records between automatic checkpoints
+
+    // Fixed-layout plan last written by exportFixedPlan
+    String publishedPlan;
+    std::streamoff* planOffsets;    // start of each room's section, by room index
+
+    // Scratch of findNearestVacancy; searches run under the read lock and
+    // take turns with it
+    SeatSearch search;
+    std::mutex searchLock;
+
+    // Many readers or one writer. Public queries take the lock shared and
+    // mutators take it exclusive; the writing thread may re-enter any public
+    // method (insertStudent -> forwardCollapse, loadFromFile -> insertStudent).
+    // A mutation also holds 'writerLock' from start to end, so between the
+    // shift and each collapse step it can drop the exclusive lock for a
+    // moment (letReadersIn) and let waiting readers in without letting
+    // another writer through.
+    std::shared_mutex rwLock;
+    std::mutex writerLock;
+    std::atomic<std::thread::id> writerThread;
+
+    class ReadGuard {
+    private:
+        BasicSeatingSystem* sys;
+        bool held;
+
+    public:
+        explicit ReadGuard(BasicSeatingSystem* system) : sys(system),
+            held(system->writerThread.load() != std::this_thread::get_id()) {
+            if (held) sys->rwLock.lock_shared();
+        }
+
+        ~ReadGuard() {
+            if (held) sys->rwLock.unlock_shared();
+        }
+    };
+
+    class WriteGuard {
+    private:
+        BasicSeatingSystem* sys;
+        bool held;
+
+    public:
+        explicit WriteGuard(BasicSeatingSystem* system) : sys(system),
+            held(system->writerThread.load() != std::this_thread::get_id()) {
+            if (held) {
+                sys->writerLock.lock();
+                sys->rwLock.lock();
+                sys->writerThread.store(std::this_thread::get_id());
+            }
+        }
+
+        ~WriteGuard() {
+            if (held) {
+                if (!sys->inTransaction) sys->commitUndo();
+                if (sys->journal) sys->commitJournal();
+                sys->writerThread.store(std::thread::id());
+                sys->rwLock.unlock();
+                sys->writerLock.unlock();
+            }
+        }
+    };
+
+    // Between two steps of a mutation, each leaving a complete seating:
+    // let readers waiting on the lock run, then take it back. Only the
+    // writing thread yields, and not inside a transaction, whose changes
+    // may still be rolled back.
+    void letReadersIn() {
+        if (inTransaction || writerThread.load() != std::this_thread::get_id()) return;
+        rwLock.unlock();
+        std::this_thread::yield();
+        rwLock.lock();
+    }
+
+    // Helper to find block
+    Block* findBlock(const char* blockID) {
+        Block* current = firstBlock;
+        while (current) {
+            if (current->blockID == blockID) return current;
+            current = current->next;
+        }
+        return nullptr;
+    }
+
+    // Helper to find floor
+    Floor* findFloor(Block* block, int floorNo) {
+        if (!block) return nullptr;
+        Floor* current = block->firstFloor;
+        while (current) {
+            if (current->floorNumber == floorNo) return current;
+            current = current->next;
+        }
+        return nullptr;
     }
 
     // Helper to find room
@@ -391,533 +2316,2641 @@ private:
         return nullptr;
     }
 
-    // Get room from seat (reverse lookup)
-    Room* getRoomFromSeat(Seat* seat, Block** outBlock, Floor** outFloor) {
-        if (!seat) return nullptr;
+    // Get room from seat (reverse lookup)
+    Room* getRoomFromSeat(Seat* seat, Block** outBlock, Floor** outFloor) {
+        if (!seat || seat->roomIndex < 0 || seat->roomIndex >= roomCount) return nullptr;
+
+        Room* room = rooms[seat->roomIndex];
+        if (outFloor) *outFloor = room->floor;
+        if (outBlock) *outBlock = room->floor ? room->floor->block : nullptr;
+        return room;
+    }
+
+    // Number blocks and rooms in traversal order and tag their seats
+    void indexRooms() {
+        blocks = new Block*[totalBlocks];
+        int blockIndex = 0;
+        roomCount = 0;
+        for (Block* block = firstBlock; block; block = block->next) {
+            blocks[blockIndex++] = block;
+            block->occupancy.parent = &occupancy;
+            for (Floor* floor = block->firstFloor; floor; floor = floor->next) {
+                roomCount += floor->totalRooms;
+            }
+        }
+
+        rooms = new Room*[roomCount];
+        int index = 0;
+        for (Block* block = firstBlock; block; block = block->next) {
+            for (Floor* floor = block->firstFloor; floor; floor = floor->next) {
+                for (Room* room = floor->firstRoom; room; room = room->next) {
+                    room->index = index;
+                    room->undo = undo;
+                    room->cursors = cursors;
+                    room->owner = this;
+                    for (int i = 0; room->grid && i < room->capacity(); i++) {
+                        room->grid[i].roomIndex = index;
+                    }
+                    rooms[index++] = room;
+                }
+            }
+        }
+    }
+
+    // ---- Copy-on-write sharing with clones (see clone) ----
+
+    // Point a clone's room at the seats and lanes of 'source', or of the
+    // room 'source' itself still shares, until unshareRoom copies them
+    void shareRoom(Room* room, Room* source) {
+        Room* root = source->origin ? source->origin : source;
+        room->origin = root;
+        room->grid = root->grid;
+        room->lanes = root->lanes;
+        room->laneOccupied[0] = source->laneOccupied[0];
+        room->laneOccupied[1] = source->laneOccupied[1];
+        room->prevSharer = nullptr;
+        room->nextSharer = root->sharers;
+        if (root->sharers) root->sharers->prevSharer = room;
+        root->sharers = room;
+        root->owner->sharedOut++;
+        sharedRooms++;
+    }
+
+    // Stop sharing; the room is left without seats
+    void leaveOrigin(Room* room) {
+        Room* root = room->origin;
+        if (!root) return;
+        if (room->prevSharer) room->prevSharer->nextSharer = room->nextSharer;
+        else root->sharers = room->nextSharer;
+        if (room->nextSharer) room->nextSharer->prevSharer = room->prevSharer;
+        room->origin = room->nextSharer = room->prevSharer = nullptr;
+        room->grid = nullptr;
+        room->lanes = nullptr;
+        root->owner->sharedOut--;
+        sharedRooms--;
+    }
+
+    // Give a shared room its own seats, linked to this system's view of
+    // the neighbouring rooms, and copies of its students in this system's
+    // pools and index. Without 'copyStudents' the seats stay vacant and the
+    // caller is about to clear the room anyway.
+    void unshareRoom(Room* room, bool copyStudents) {
+        static Seat* Seat::* const links[8] = { &Seat::front, &Seat::back, &Seat::left,
+            &Seat::right, &Seat::up, &Seat::down, &Seat::leftBuilding, &Seat::rightBuilding };
+
+        Room* root = room->origin;
+        if (!root) return;
+        leaveOrigin(room);
+        room->allocateSeats();
+
+        const int cap = room->capacity();
+        for (int i = 0; i < cap; i++) {
+            Seat* from = &root->grid[i];
+            Seat* to = &room->grid[i];
+
+            // Links inside the room are wired already; links are paired, so
+            // a neighbour with its own seats gets the way back (links[d ^ 1])
+            for (int d = 0; d < 8; d++) {
+                Seat* target = from->*links[d];
+                if (!target || target->roomIndex == room->index) continue;
+                Room* other = rooms[target->roomIndex];
+                Seat* mapped = other->getSeat(target->row, target->col);
+                to->*links[d] = mapped;
+                if (!other->origin) mapped->*links[d ^ 1] = to;
+            }
+
+            Student* student = from->student;
+            if (!copyStudents || !student) continue;
+            Student* copy = pools[student->batchID & 1].allocate(student->rollNumber,
+                student->batchID, subjects.name(student->subjectId), student->subjectId);
+            copy->seat = to;
+            to->student = copy;
+            students.add(copy);
+        }
+        if (copyStudents) {
+            for (int i = 0; i < 3 * cap; i++) room->lanes[i] = root->lanes[i];
+        }
+    }
+
+    // A room about to be written stops sharing
+    Room* ownRoom(Room* room) {
+        if (room->origin) unshareRoom(room, true);
+        return room;
+    }
+
+    // 'seat' of 'room' as it is once the room stops sharing
+    Seat* ownSeat(Room* room, Seat* seat) {
+        if (!room->origin) return seat;
+        unshareRoom(room, true);
+        return room->getSeat(seat->row, seat->col);
+    }
+
+    // Before the lanes run on separate threads, rooms shared in either
+    // direction get their own seats
+    void isolateRooms() {
+        if (sharedRooms.load() == 0 && sharedOut.load() == 0) return;
+        for (int i = 0; i < roomCount; i++) {
+            ownRoom(rooms[i]);
+            rooms[i]->releaseSharers();
+        }
+    }
+
+    // The index holds this system's own records only, so queries that use
+    // it make a clone stop sharing first
+    void unshareAll() {
+        if (sharedRooms.load() == 0) return;
+        WriteGuard guard(this);
+        for (int i = 0; i < roomCount; i++) ownRoom(rooms[i]);
+    }
+
+    int side() const {
+        return N > 0 ? N : gridSize;
+    }
+
+    int parityOf(int batchID) {
+        return batchID % 2 == 1 ? 1 : 0;
+    }
+
+    // Check batch parity
+    bool matchesParity(int batchID, int col) {
+        bool oddBatch = (batchID % 2 == 1);
+        bool oddCol = (col % 2 == 1);
+        return oddBatch == oddCol;
+    }
+
+    // Count occupied seats in parity columns for a batch
+    int countOccupiedInParity(Room* room, int batchID) {
+        int parity = parityOf(batchID);
+        return laneKernels().countEqual(room->laneBatches(parity), room->laneLength(parity), batchID);
+    }
+
+    // Count different subjects in parity columns for a batch
+    int countSubjectsInParity(Room* room, int batchID, const char* excludeSubject) {
+        return countSubjectsInParity(room, batchID, subjects.find(excludeSubject));
+    }
+
+    int countSubjectsInParity(Room* room, int batchID, int excludeSubjectId) {
+        int parity = parityOf(batchID);
+        const int* batches = room->laneBatches(parity);
+        const int* subjectIds = room->laneSubjects(parity);
+        int n = room->laneLength(parity);
+
+        if (laneKernels().countOtherSubject(batches, subjectIds, n, batchID, excludeSubjectId) == 0) {
+            return 0;
+        }
+
+        int seen[10];
+        int subjectCount = 0;
+        for (int i = 0; i < n; i++) {
+            if (batches[i] != batchID || subjectIds[i] == excludeSubjectId) continue;
+
+            bool found = false;
+            for (int k = 0; k < subjectCount; k++) {
+                if (seen[k] == subjectIds[i]) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found && subjectCount < 10) {
+                seen[subjectCount] = subjectIds[i];
+                subjectCount++;
+            }
+        }
+        return subjectCount;
+    }
+
+    // Check subject restriction
+    bool checkSubjectRestriction(Room* room, int batchID, const char* subject) {
+        return checkSubjectRestriction(room, batchID, subjects.find(subject));
+    }
+
+    bool checkSubjectRestriction(Room* room, int batchID, int subjectId) {
+        int parityOccupied = countOccupiedInParity(room, batchID);
+        int maxParitySeats = (side() * side()) / 2;
+
+        if (parityOccupied > maxParitySeats / 2) {
+            int parity = parityOf(batchID);
+            int others = laneKernels().countOtherSubject(room->laneBatches(parity),
+                room->laneSubjects(parity), room->laneLength(parity), batchID, subjectId);
+            if (others > 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Adjacency rule, when on: no student of 'subjectId' directly in front
+    // of, behind or beside 'seat' in its room. 'moving' is about to leave
+    // its own seat and does not count.
+    bool adjacencyAllows(Seat* seat, int subjectId, const Student* moving = nullptr) {
+        if (!adjacencyRule) return true;
+        Seat* near[4] = { seat->front, seat->back, seat->left, seat->right };
+        for (int d = 0; d < 4; d++) {
+            Seat* other = near[d];
+            if (!other || other->roomIndex != seat->roomIndex) continue;
+            if (other->student && other->student != moving && other->student->subjectId == subjectId) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Run fn(0) and fn(1), one per parity lane. Left and right neighbours
+    // sit in the other lane, so under the adjacency rule the lanes run one
+    // after the other.
+    template <class Fn>
+    void forEachLane(Fn& fn) {
+        if (adjacencyRule) {
+            fn(0);
+            fn(1);
+        }
+        else {
+            sharedPool().parallelFor(2, fn);
+        }
+    }
+
+    static const int kNoFastPath = -1;
+    static const int kLaneFull = -2;
+
+    // Students seated in a parity lane across the building
+    int laneOccupancy(int parity) const {
+        int seated = 0;
+        for (int batch = kFirstBatch; batch < kFirstBatch + kBatchCount; batch++) {
+            if (batch % 2 == parity) seated += occupancy.ofBatch(batch);
+        }
+        return seated;
+    }
+
+    // Append fast path of findInsertionPosition. When the lane's students
+    // fill a prefix of it and 'rollNo' is not below any of them, the search
+    // would stop at the first vacancy the subject restriction allows: the
+    // tail seat, or else the start of the next (empty) room. Returns that
+    // lane position with its room, kLaneFull, or kNoFastPath.
+    int appendPosition(int rollNo, int batchID, int subjectId, Room** outRoom) {
+        int parity = parityOf(batchID);
+        LaneCursor& cursor = cursors[parity];
+        int seated = laneOccupancy(parity);
+        if (seated == 0) cursor = LaneCursor();
+        if (rollNo < cursor.maxRoll || seated != cursor.tail) return kNoFastPath;
+
+        const int laneLen = rooms[0]->laneLength(parity);
+        if (laneLen == 0) return kLaneFull;
+        int i = cursor.tail / laneLen;
+        int pos = cursor.tail % laneLen;
+        if (i < roomCount && !checkSubjectRestriction(rooms[i], batchID, subjectId)) {
+            i++;
+            pos = 0;
+        }
+        if (i >= roomCount) return kLaneFull;
+        if (!adjacencyAllows(rooms[i]->laneSeat(parity, pos), subjectId)) return kNoFastPath;
+
+        *outRoom = rooms[i];
+        return pos;
+    }
+
+    // Further students of 'batchID' taking 'subjectId' a room can accept:
+    // its free seats in the batch's lane, unless other subjects of the batch
+    // sit there, in which case the restriction closes the room once the
+    // batch passes half of its parity seats
+    int roomCapacityFor(Room* room, int batchID, int subjectId) {
+        int parity = parityOf(batchID);
+        int free = room->laneLength(parity) - room->laneOccupied[parity];
+        int others = laneKernels().countOtherSubject(room->laneBatches(parity),
+            room->laneSubjects(parity), room->laneLength(parity), batchID, subjectId);
+        if (others == 0) return free;
+
+        int open = (side() * side()) / 2 / 2 - countOccupiedInParity(room, batchID) + 1;
+        if (open < 0) open = 0;
+        return open < free ? open : free;
+    }
+
+    // Sum of roomCapacityFor over the building, optionally room by room
+    int buildingCapacityFor(int batchID, int subjectId, int* perRoom) {
+        int total = 0;
+        for (int i = 0; i < roomCount; i++) {
+            int open = roomCapacityFor(rooms[i], batchID, subjectId);
+            if (perRoom) perRoom[i] = open;
+            total += open;
+        }
+        return total;
+    }
+
+    // Find insertion position
+    Seat* findInsertionPosition(int rollNo, int batchID, const char* subject,
+        Block** outBlock, Floor** outFloor, Room** outRoom) {
+        return findInsertionPosition(rollNo, batchID, subjects.find(subject),
+            outBlock, outFloor, outRoom);
+    }
+
+    Seat* findInsertionPosition(int rollNo, int batchID, int subjectId,
+        Block** outBlock, Floor** outFloor, Room** outRoom) {
+        int parity = parityOf(batchID);
+
+        Room* tailRoom = nullptr;
+        int tailPos = appendPosition(rollNo, batchID, subjectId, &tailRoom);
+        if (tailPos == kLaneFull) return nullptr;
+        if (tailPos >= 0) {
+            if (outBlock) *outBlock = tailRoom->floor->block;
+            if (outFloor) *outFloor = tailRoom->floor;
+            if (outRoom) *outRoom = tailRoom;
+            return tailRoom->laneSeat(parity, tailPos);
+        }
+
+        Room* room = nullptr;
+        Seat* seat = findPositionIn(0, roomCount, rollNo, batchID, subjectId, &room);
+        if (!seat) return nullptr;
+        if (outBlock) *outBlock = room->floor->block;
+        if (outFloor) *outFloor = room->floor;
+        if (outRoom) *outRoom = room;
+        return seat;
+    }
+
+    // Slow path of findInsertionPosition over rooms [firstRoom, endRoom).
+    // Column-major traversal of the batch's parity columns, one lane per room:
+    // stop at the first larger roll, or the first vacancy the subject
+    // restriction allows.
+    Seat* findPositionIn(int firstRoom, int endRoom, int rollNo, int batchID, int subjectId,
+        Room** outRoom) {
+        const LaneKernels& kernels = laneKernels();
+        int parity = parityOf(batchID);
+        for (int i = firstRoom; i < endRoom; i++) {
+            Room* room = rooms[i];
+            const int* rolls = room->laneRolls(parity);
+            int n = room->laneLength(parity);
+
+            int hit = kernels.findFirstAbove(rolls, n, rollNo, true);
+            if (hit >= 0 && rolls[hit] == kVacantRoll &&
+                !checkSubjectRestriction(room, batchID, subjectId)) {
+                int rest = kernels.findFirstAbove(rolls + hit + 1, n - hit - 1, rollNo, false);
+                hit = rest < 0 ? -1 : hit + 1 + rest;
+            }
+
+            // A seat next to the same subject is passed over for the next
+            // candidate in the lane
+            if (hit >= 0 && adjacencyRule) {
+                bool vacanciesOpen = checkSubjectRestriction(room, batchID, subjectId);
+                while (hit >= 0 && !adjacencyAllows(room->laneSeat(parity, hit), subjectId)) {
+                    int rest = kernels.findFirstAbove(rolls + hit + 1, n - hit - 1, rollNo,
+                        vacanciesOpen);
+                    hit = rest < 0 ? -1 : hit + 1 + rest;
+                }
+            }
+            if (hit < 0) continue;
+
+            *outRoom = room;
+            return room->laneSeat(parity, hit);
+        }
+        return nullptr;
+    }
+
+    // Connect vertical pointers (up/down)
+    void connectVertically() {
+        Block* block = firstBlock;
+        while (block) {
+            Floor* floor = block->firstFloor;
+            Floor* floorAbove = nullptr;
+
+            while (floor) {
+                if (floorAbove) {
+                    Room* room = floor->firstRoom;
+                    Room* roomAbove = floorAbove->firstRoom;
+
+                    while (room && roomAbove) {
+                        for (int r = 0; r < side(); r++) {
+                            for (int c = 0; c < side(); c++) {
+                                Seat* seat = room->getSeat(r, c);
+                                Seat* seatAbove = roomAbove->getSeat(r, c);
+                                if (seat && seatAbove) {
+                                    seat->up = seatAbove;
+                                    seatAbove->down = seat;
+                                }
+                            }
+                        }
+                        room = room->next;
+                        roomAbove = roomAbove->next;
+                    }
+                }
+                floorAbove = floor;
+                floor = floor->next;
+            }
+            block = block->next;
+        }
+    }
+
+    // Connect cross-block pointers
+    void connectCrossBlock() {
+        Block* block = firstBlock;
+        while (block && block->next) {
+            Block* nextBlock = block->next;
+
+            Floor* floor1 = block->firstFloor;
+            Floor* floor2 = nextBlock->firstFloor;
+
+            while (floor1 && floor2) {
+                Room* room1 = floor1->firstRoom;
+                Room* room2 = floor2->firstRoom;
+
+                while (room1 && room2) {
+                    for (int r = 0; r < side(); r++) {
+                        Seat* rightmost = room1->getSeat(r, side() - 1);
+                        Seat* leftmost = room2->getSeat(r, 0);
+
+                        if (rightmost && leftmost) {
+                            rightmost->rightBuilding = leftmost;
+                            leftmost->leftBuilding = rightmost;
+                        }
+                    }
+                    room1 = room1->next;
+                    room2 = room2->next;
+                }
+                floor1 = floor1->next;
+                floor2 = floor2->next;
+            }
+            block = block->next;
+        }
+    }
+
+    // Connect floor continuity
+    void connectFloorContinuity() {
+        Block* block = firstBlock;
+        while (block) {
+            Floor* floor = block->firstFloor;
+            while (floor && floor->next) {
+                Room* lastRoom = floor->lastRoom;
+                Room* firstRoomNext = floor->next->firstRoom;
+
+                if (lastRoom && firstRoomNext) {
+                    for (int r = 0; r < side(); r++) {
+                        Seat* lastCol = lastRoom->getSeat(r, side() - 1);
+                        Seat* firstCol = firstRoomNext->getSeat(r, 0);
+
+                        if (lastCol && firstCol) {
+                            lastCol->right = firstCol;
+                            firstCol->left = lastCol;
+                        }
+                    }
+                }
+                floor = floor->next;
+            }
+
+            // Connect top floor of current block to bottom floor of next block
+            if (block->next) {
+                Room* topLastRoom = block->lastFloor->lastRoom;
+                Room* nextBottomFirst = block->next->firstFloor->firstRoom;
+
+                if (topLastRoom && nextBottomFirst) {
+                    for (int r = 0; r < side(); r++) {
+                        Seat* lastSeat = topLastRoom->getSeat(r, side() - 1);
+                        Seat* firstSeat = nextBottomFirst->getSeat(r, 0);
+
+                        if (lastSeat && firstSeat) {
+                            lastSeat->right = firstSeat;
+                            firstSeat->left = lastSeat;
+                        }
+                    }
+                }
+            }
+            block = block->next;
+        }
+    }
+
+    // Default name of the block at 'index': A to Z, then AA, AB, ... as
+    // spreadsheet columns are named
+    static String defaultBlockID(int index) {
+        char reversed[16];
+        int length = 0;
+        for (int n = index + 1; n > 0; n = (n - 1) / 26) reversed[length++] = 'A' + (n - 1) % 26;
+        char name[16];
+        for (int i = 0; i < length; i++) name[i] = reversed[length - 1 - i];
+        name[length] = '\0';
+        return String(name);
+    }
+
+    // Build and wire totalBlocks blocks of the given shape. Blocks take
+    // their names from 'blockIDs' when given, else the default names; an
+    // empty or repeated name is replaced by the default one.
+    void build(int floorsPerBlock, int roomsPerFloor, const char* const* blockIDs = nullptr) {
+        Block* prevBlock = nullptr;
+
+        for (int i = 0; i < totalBlocks; i++) {
+            String name = defaultBlockID(i);
+            if (blockIDs && blockIDs[i] && blockIDs[i][0]) {
+                if (findBlock(blockIDs[i])) {
+                    std::cout << "Error: Duplicate block ID " << blockIDs[i] << "; using "
+                        << name.c_str() << "!\n";
+                }
+                else {
+                    name = blockIDs[i];
+                }
+            }
+            Block* block = new Block(name.c_str(), floorsPerBlock, roomsPerFloor, side());
+
+            if (!firstBlock) firstBlock = block;
+            if (prevBlock) {
+                prevBlock->next = block;
+                block->prev = prevBlock;
+            }
+            prevBlock = block;
+        }
+        lastBlock = prevBlock;
+
+        connectVertically();
+        connectCrossBlock();
+        connectFloorContinuity();
+        indexRooms();
+    }
+
+    // ---- Placement primitives shared by the public API and applyInLanes ----
+    // Every primitive touches only the parity lane of the student involved.
+
+    enum PlaceResult { PlacedInVacancy, PlacedByShift, NoSeat, ShiftFailed };
+
+    // Per-lane bookkeeping while applyInLanes runs the lanes in parallel.
+    // Covers rooms [firstRoom, endRoom): the building, or one block shard.
+    struct LaneContext {
+        int parity;
+        int firstRoom;
+        int endRoom;        // backward walks stop before this room
+        bool* flagged;      // rooms awaiting a roomCollapse check, from firstRoom
+
+        LaneContext(int p, int first, int end) : parity(p), firstRoom(first), endRoom(end),
+            flagged(new bool[end - first]) {
+            for (int i = 0; i < end - first; i++) flagged[i] = false;
+        }
+
+        ~LaneContext() {
+            delete[] flagged;
+        }
+
+        void flag(int room) {
+            flagged[room - firstRoom] = true;
+        }
+
+        void unflag(int room) {
+            flagged[room - firstRoom] = false;
+        }
+
+        bool isFlagged(int room) const {
+            return room >= firstRoom && room < endRoom && flagged[room - firstRoom];
+        }
+    };
+
+    // Rooms one lane's ops changed, with the lane's count in each room just
+    // after the change; applyInLanes replays these in batch order.
+    struct RoomTrail {
+        int* rooms;
+        int* counts;
+        int size;
+        int capacity;
+
+        RoomTrail() : rooms(nullptr), counts(nullptr), size(0), capacity(0) {
+        }
+
+        ~RoomTrail() {
+            delete[] rooms;
+            delete[] counts;
+        }
+
+        void add(int room, int count) {
+            if (size == capacity) {
+                int newCapacity = capacity ? capacity * 2 : 64;
+                int* grownRooms = new int[newCapacity];
+                int* grownCounts = new int[newCapacity];
+                for (int i = 0; i < size; i++) {
+                    grownRooms[i] = rooms[i];
+                    grownCounts[i] = counts[i];
+                }
+                delete[] rooms;
+                delete[] counts;
+                rooms = grownRooms;
+                counts = grownCounts;
+                capacity = newCapacity;
+            }
+            rooms[size] = room;
+            counts[size] = count;
+            size++;
+        }
+    };
+
+    // Where a backward collapse stands, so it can go on in a later range of rooms
+    struct BackwardWalk {
+        Seat* deletedSeat;
+        Seat* vacancy;
+        bool foundDeleted;
+        int lastPlacedRoll;     // To maintain ascending roll order
+    };
+
+    // One block's worker while applyInBlocks runs. The block's rooms log
+    // into 'undo' and 'cursors' here instead of the system's. Ops arrive in
+    // 'inbox' in batch order; while an op holds the block it may still seat,
+    // move or pour students here, and the worker waits for it to let go.
+    struct BlockOwner {
+        int firstRoom;
+        int endRoom;
+        UndoLog undo[2];
+        LaneCursor cursors[2];
+        LaneContext context;        // rooms flagged by the delete in progress
+        UndoLog::Mark start[2];     // the logs as the latest op arrived
+        int* inbox;
+        int head;
+        int tail;
+        int holder;                 // op holding the block, or -1
+        int nextHeld;               // next block the holder holds, or -1
+        std::condition_variable wake;
+        std::thread worker;
+
+        BlockOwner(int first, int end, int maxOps) : firstRoom(first), endRoom(end),
+            context(-1, first, end), inbox(new int[maxOps > 0 ? maxOps : 1]), head(0), tail(0),
+            holder(-1), nextHeld(-1) {
+        }
+
+        ~BlockOwner() {
+            delete[] inbox;
+        }
+    };
+
+    // An applyInBlocks op on its way through the blocks. Only the block
+    // worker it is with reads or writes it.
+    struct BlockWave {
+        Student* student;       // insert: the student still looking for a seat
+        bool shifting;          // insert: a forward shift is under way
+        BackwardWalk walk;      // delete: walk.deletedSeat is null until found
+        Student* removed;
+        int firstHeld;          // held blocks, linked through BlockOwner::nextHeld
+        int lastHeld;
+        int outcome;            // 0 placed, 1 deleted, 2 failed
+    };
+
+    // Small open-addressing map from roll number to an int, e.g. a lane or an op
+    class RollMap {
+    private:
+        int* keys;
+        int* values;
+        bool* used;
+        int mask;
+
+    public:
+        explicit RollMap(int expected) {
+            int capacity = 16;
+            while (capacity < expected * 2) capacity *= 2;
+            keys = new int[capacity];
+            values = new int[capacity];
+            used = new bool[capacity];
+            for (int i = 0; i < capacity; i++) used[i] = false;
+            mask = capacity - 1;
+        }
+
+        ~RollMap() {
+            delete[] keys;
+            delete[] values;
+            delete[] used;
+        }
+
+        void put(int key, int value) {
+            int i = (static_cast<unsigned>(key) * 2654435761u) & mask;
+            while (used[i] && keys[i] != key) i = (i + 1) & mask;
+            used[i] = true;
+            keys[i] = key;
+            values[i] = value;
+        }
+
+        int get(int key) const {
+            int i = (static_cast<unsigned>(key) * 2654435761u) & mask;
+            while (used[i]) {
+                if (keys[i] == key) return values[i];
+                i = (i + 1) & mask;
+            }
+            return -1;
+        }
+    };
+
+    PlaceResult placeStudent(int rollNo, int batchID, int subjectId) {
+        Block* targetBlock = nullptr;
+        Floor* targetFloor = nullptr;
+        Room* targetRoom = nullptr;
+
+        Seat* targetSeat = findInsertionPosition(rollNo, batchID, subjectId,
+            &targetBlock, &targetFloor, &targetRoom);
+        if (!targetSeat) return NoSeat;
+        targetSeat = ownSeat(targetRoom, targetSeat);
+
+        Student* newStudent = pools[batchID & 1].allocate(rollNo, batchID,
+            subjects.name(subjectId), subjectId);
+
+        if (!targetSeat->student) {
+            targetRoom->setStudent(targetSeat, newStudent);
+            admit(newStudent);
+            return PlacedInVacancy;
+        }
+
+        int lane = targetSeat->col % 2;
+        UndoLog::Mark mark = undo[lane].mark();
+        if (!shiftForward(targetSeat, newStudent, targetRoom)) {
+            rollbackTo(lane, mark);
+            pools[batchID & 1].release(newStudent);
+            return ShiftFailed;
+        }
+        admit(newStudent);
+        return PlacedByShift;
+    }
+
+    // A placed student joins the indexes
+    void admit(Student* student) {
+        students.add(student);
+        undo[student->batchID & 1].admitted(student);
+    }
+
+    // A vacated student leaves the indexes; it is freed when the operation commits
+    void retire(Student* student) {
+        students.remove(student);
+        undo[student->batchID & 1].retiredStudent(student);
+    }
+
+    // Undo one lane's changes back to 'mark'
+    void rollbackTo(int lane, const UndoLog::Mark& mark) {
+        undo[lane].rollbackTo(mark, students, pools[lane], [this](Seat* seat, Student* previous) {
+            rooms[seat->roomIndex]->setStudent(seat, previous);
+        });
+    }
+
+    void commitUndo() {
+        undo[0].commit(pools[0]);
+        undo[1].commit(pools[1]);
+    }
+
+    // Commit the undo logs and journal, then release the transaction's lock
+    void endTransaction() {
+        commitUndo();
+        inTransaction = false;
+        if (journal) commitJournal();
+        writerThread.store(std::thread::id());
+        rwLock.unlock();
+        writerLock.unlock();
+    }
+
+    // Forward collapse body; false if the displacement chain found no seat,
+    // in which case the caller rolls the lane's undo log back
+    bool shiftForward(Seat* startSeat, Student* newStudent, Room* startRoom) {
+        if (!startSeat || !newStudent) return true;
+        if (!startRoom) startRoom = getRoomFromSeat(startSeat, nullptr, nullptr);
+
+        if (!startSeat->student) {
+            startRoom->setStudent(startSeat, newStudent);
+            return true;
+        }
+
+        Student* displaced = startSeat->student;
+        startRoom->setStudent(startSeat, newStudent);
+
+        Block* block = nullptr;
+        Floor* floor = nullptr;
+        Room* room = nullptr;
+
+        Seat* nextSeat = findInsertionPosition(displaced->rollNumber, displaced->batchID,
+            displaced->subjectId, &block, &floor, &room);
+
+        if (!nextSeat) return false;
+
+        return shiftForward(ownSeat(room, nextSeat), displaced, room);
+    }
+
+    // Forward shift confined to rooms [firstRoom, endRoom), for a block
+    // shard. Returns the student the ripple pushed past the last room, left
+    // unseated, or nullptr once everyone has a seat.
+    Student* shiftForwardIn(int firstRoom, int endRoom, Seat* seat, Student* student, Room* room) {
+        while (seat->student) {
+            Student* displaced = seat->student;
+            room->setStudent(seat, student);
+            seat = findPositionIn(firstRoom, endRoom, displaced->rollNumber, displaced->batchID,
+                displaced->subjectId, &room);
+            if (!seat) return displaced;
+            student = displaced;
+        }
+        room->setStudent(seat, student);
+        return nullptr;
+    }
+
+    // First seat holding 'rollNo', rooms in order and row-major within a
+    // room; parity limits the search to one lane's columns (-1 for all)
+    Seat* findRollSeat(int rollNo, int parity, Room** outRoom) {
+        return findRollSeat(rollNo, parity, outRoom, 0, roomCount);
+    }
 
-        Block* block = firstBlock;
-        while (block) {
-            Floor* floor = block->firstFloor;
-            while (floor) {
-                Room* room = floor->firstRoom;
-                while (room) {
-                    for (int r = 0; r < gridSize; r++) {
-                        for (int c = 0; c < gridSize; c++) {
-                            if (room->getSeat(r, c) == seat) {
-                                if (outBlock) *outBlock = block;
-                                if (outFloor) *outFloor = floor;
-                                return room;
-                            }
-                        }
+    Seat* findRollSeat(int rollNo, int parity, Room** outRoom, int firstRoom, int endRoom) {
+        int step = parity < 0 ? 1 : 2;
+        int first = parity < 0 ? 0 : parity;
+        for (int i = firstRoom; i < endRoom; i++) {
+            Room* room = rooms[i];
+            if ((parity < 0 ? room->occupiedSeats() : room->laneOccupied[parity]) == 0) continue;
+            for (int r = 0; r < side(); r++) {
+                for (int c = first; c < side(); c += step) {
+                    Seat* seat = room->getSeat(r, c);
+                    if (seat->student && seat->student->rollNumber == rollNo) {
+                        if (outRoom) *outRoom = room;
+                        return seat;
                     }
-                    room = room->next;
                 }
-                floor = floor->next;
             }
-            block = block->next;
         }
         return nullptr;
     }
 
-    // Check batch parity
-    bool matchesParity(int batchID, int col) {
-        bool oddBatch = (batchID % 2 == 1);
-        bool oddCol = (col % 2 == 1);
-        return oddBatch == oddCol;
+    // Delete body shared by deleteStudent and the lane engine
+    bool removeStudent(int rollNo, int parity, LaneContext* lane) {
+        Room* room = nullptr;
+        Seat* seat = findRollSeat(rollNo, parity, &room);
+        if (!seat) return false;
+        seat = ownSeat(room, seat);
+
+        Student* removed = seat->student;
+        room->setStudent(seat, nullptr);
+        retire(removed);
+
+        if (lane) {
+            shiftBackward(seat, lane);
+            flagForCollapse(room, lane);
+            return true;
+        }
+
+        LaneContext local(seat->col % 2, 0, roomCount);
+        shiftBackward(seat, &local);
+        flagForCollapse(room, &local);
+        runDeferredCollapses(&local, 1);
+        return true;
     }
 
-    // Count occupied seats in parity columns for a batch
-    int countOccupiedInParity(Room* room, int batchID) {
-        int count = 0;
-        bool oddBatch = (batchID % 2 == 1);
+    // Rooms that lost students are checked for under-fill only once the
+    // shifting that emptied them is over; a collapse mid-walk could pour
+    // students into the very vacancy being filled.
+    void flagForCollapse(Room* room, LaneContext* lane) {
+        lane->flag(room->index);
+    }
 
-        for (int col = 0; col < gridSize; col++) {
-            bool oddCol = (col % 2 == 1);
-            if (oddBatch != oddCol) continue;
+    // Room collapses flagged by any of the lanes, in traversal order
+    void runDeferredCollapses(LaneContext* lanes, int laneCount) {
+        for (int i = 0; i < roomCount; i++) {
+            bool flagged = false;
+            for (int l = 0; l < laneCount; l++) flagged = flagged || lanes[l].isFlagged(i);
+            if (flagged && rooms[i]->occupiedSeats() < rooms[i]->getMinOccupancy()) {
+                letReadersIn();
+                roomCollapse(rooms[i]);
+            }
+        }
+    }
 
-            for (int row = 0; row < gridSize; row++) {
-                Seat* seat = room->getSeat(row, col);
-                if (seat && seat->student && seat->student->batchID == batchID) {
-                    count++;
+    // Bulk relocation behind roomCollapse: the front of each of the room's
+    // parity lanes moves, in order, into the free tail of the matching lane
+    // of the room before it in traversal order. Stops per lane at the first
+    // student that would break roll order, the subject restriction or the
+    // adjacency rule there.
+    // Returns the number of students moved.
+    int pourIntoPrevious(Room* room) {
+        if (!room || room->index <= 0) return 0;
+        Room* prev = rooms[room->index - 1];
+        int moved = 0;
+
+        for (int parity = 0; parity < 2; parity++) {
+            const int* prevRolls = prev->laneRolls(parity);
+            int n = prev->laneLength(parity);
+            int last = n - 1;
+            while (last >= 0 && prevRolls[last] == kVacantRoll) last--;
+            int lastRoll = last >= 0 ? prevRolls[last] : kVacantRoll;
+            int slot = last + 1;
+
+            // Decided on the lanes, so shared rooms are copied only for a move
+            int m = room->laneLength(parity);
+            for (int i = 0; i < m && slot < n; i++) {
+                int roll = room->laneRolls(parity)[i];
+                if (roll == kVacantRoll) continue;
+                if (roll < lastRoll) break;
+                if (!checkSubjectRestriction(prev, room->laneBatches(parity)[i],
+                    room->laneSubjects(parity)[i])) break;
+                if (!adjacencyAllows(prev->laneSeat(parity, slot), room->laneSubjects(parity)[i])) {
+                    break;
                 }
+
+                ownRoom(prev);
+                Seat* seat = ownRoom(room)->laneSeat(parity, i);
+                Student* student = seat->student;
+                room->setStudent(seat, nullptr);
+                prev->setStudent(prev->laneSeat(parity, slot++), student);
+                lastRoll = roll;
+                moved++;
             }
         }
-        return count;
+        return moved;
     }
 
-    // Count different subjects in parity columns for a batch
-    int countSubjectsInParity(Room* room, int batchID, const char* excludeSubject) {
-        String subjects[10];
-        int subjectCount = 0;
-        bool oddBatch = (batchID % 2 == 1);
+    // Bodies of roomCollapse, floorCollapse and blockCollapse for rooms
+    // [firstRoom, roomCount), reporting to 'out'. False, with the pours so
+    // far left for the caller to undo, when a pour would reach past
+    // firstRoom into the room before it; never for firstRoom 0.
+    bool collapseRoomIn(int firstRoom, Room* room, std::ostream& out) {
+        if (!room) return true;
+        if (room->index == firstRoom && firstRoom > 0) return false;
+
+        int moved = pourIntoPrevious(room);
+        if (moved == 0) return true;
+
+        Floor* floor = room->floor;
+        out << "Room collapse: moved " << moved << " students out of Block "
+            << floor->block->blockID.c_str() << " - Floor " << floor->floorNumber
+            << " - Room " << room->roomNumber << ".\n";
+
+        if (floor->occupiedSeats() < floor->getMinOccupancy()) {
+            letReadersIn();
+            return collapseFloorIn(firstRoom, floor, out);
+        }
+        return true;
+    }
 
-        for (int col = 0; col < gridSize; col++) {
-            bool oddCol = (col % 2 == 1);
-            if (oddBatch != oddCol) continue;
-
-            for (int row = 0; row < gridSize; row++) {
-                Seat* seat = room->getSeat(row, col);
-                if (seat && seat->student && seat->student->batchID == batchID) {
-                    if (!(seat->student->subject == excludeSubject)) {
-                        bool found = false;
-                        for (int i = 0; i < subjectCount; i++) {
-                            if (subjects[i] == seat->student->subject.c_str()) {
-                                found = true;
-                                break;
-                            }
-                        }
-                        if (!found && subjectCount < 10) {
-                            subjects[subjectCount] = seat->student->subject.c_str();
-                            subjectCount++;
-                        }
-                    }
-                }
+    bool collapseFloorIn(int firstRoom, Floor* floor, std::ostream& out) {
+        if (!floor) return true;
+
+        int moved = 0;
+        for (Room* room = floor->firstRoom; room; room = room->next) {
+            if (room->index == firstRoom && firstRoom > 0) return false;
+            moved += pourIntoPrevious(room);
+        }
+        if (moved == 0) return true;
+
+        out << "Floor collapse: moved " << moved << " students on Block "
+            << floor->block->blockID.c_str() << " - Floor " << floor->floorNumber << ".\n";
+
+        if (floor->block->occupiedSeats() < floor->block->getMinOccupancy()) {
+            letReadersIn();
+            return collapseBlockIn(firstRoom, floor->block, out);
+        }
+        return true;
+    }
+
+    bool collapseBlockIn(int firstRoom, Block* block, std::ostream& out) {
+        if (!block) return true;
+
+        int moved = 0;
+        for (Floor* floor = block->firstFloor; floor; floor = floor->next) {
+            for (Room* room = floor->firstRoom; room; room = room->next) {
+                if (room->index == firstRoom && firstRoom > 0) return false;
+                moved += pourIntoPrevious(room);
             }
         }
-        return subjectCount;
+        if (moved > 0) {
+            out << "Block collapse: moved " << moved << " students in Block "
+                << block->blockID.c_str() << ".\n";
+        }
+        return true;
     }
 
-    // Check subject restriction
-    bool checkSubjectRestriction(Room* room, int batchID, const char* subject) {
-        int parityOccupied = countOccupiedInParity(room, batchID);
-        int maxParitySeats = (gridSize * gridSize) / 2;
+    // Stable merge sort by roll number
+    static void sortByRoll(Student** items, int count) {
+        Student** buffer = new Student*[count > 0 ? count : 1];
+        for (int width = 1; width < count; width *= 2) {
+            for (int lo = 0; lo < count; lo += 2 * width) {
+                int mid = lo + width < count ? lo + width : count;
+                int hi = lo + 2 * width < count ? lo + 2 * width : count;
+                int a = lo;
+                int b = mid;
+                int out = lo;
+                while (a < mid && b < hi) {
+                    buffer[out++] = items[b]->rollNumber < items[a]->rollNumber ? items[b++] : items[a++];
+                }
+                while (a < mid) buffer[out++] = items[a++];
+                while (b < hi) buffer[out++] = items[b++];
+            }
+            for (int i = 0; i < count; i++) items[i] = buffer[i];
+        }
+        delete[] buffer;
+    }
 
-        if (parityOccupied > maxParitySeats / 2) {
-            int existingSubjects = countSubjectsInParity(room, batchID, subject);
-            if (existingSubjects > 0) {
-                return false;
+    // Seat one lane's students, already in roll order, from the start of the
+    // building: each takes the next lane seat, moving on to the next room when
+    // the room is full or the subject restriction turns the student away.
+    // False if the lane runs out of rooms.
+    bool packLane(int parity, Student** list, int count) {
+        const int laneLen = rooms[0]->laneLength(parity);
+        int i = 0;
+        int pos = 0;
+        for (int k = 0; k < count; k++) {
+            while (i < roomCount) {
+                if (pos < laneLen &&
+                    checkSubjectRestriction(rooms[i], list[k]->batchID, list[k]->subjectId)) {
+                    if (adjacencyAllows(rooms[i]->laneSeat(parity, pos), list[k]->subjectId)) break;
+                    pos++;  // left empty: next to the same subject
+                    continue;
+                }
+                i++;
+                pos = 0;
             }
+            if (i == roomCount) return false;
+            rooms[i]->setStudent(rooms[i]->laneSeat(parity, pos++), list[k]);
         }
         return true;
     }
 
-    // Find insertion position
-    Seat* findInsertionPosition(int rollNo, int batchID, const char* subject,
-        Block** outBlock, Floor** outFloor, Room** outRoom) {
-        Block* block = firstBlock;
+    // Vacate every student 'match' accepts in one pass over the building,
+    // then close the gaps with one compaction pass per parity lane.
+    // Returns the number of students removed.
+    template <class Match>
+    int removeMatching(Match match) {
+        isolateRooms();
+        const int cap = rooms[0]->capacity();
+        bool* vacated = new bool[roomCount * cap];
+        int firstRoom[2] = { roomCount, roomCount };
+        int vacancies[2] = { 0, 0 };
+        LaneContext lanes[2] = { LaneContext(0, 0, roomCount), LaneContext(1, 0, roomCount) };
+
+        for (int i = 0; i < roomCount; i++) {
+            Room* room = rooms[i];
+            for (int r = 0; r < side(); r++) {
+                for (int c = 0; c < side(); c++) {
+                    Seat* seat = room->getSeat(r, c);
+                    vacated[i * cap + seat->lane] = false;
+                    if (!seat->student || !match(seat->student)) continue;
+
+                    Student* removed = seat->student;
+                    room->setStudent(seat, nullptr);
+                    retire(removed);
+
+                    int parity = c % 2;
+                    vacated[i * cap + seat->lane] = true;
+                    vacancies[parity]++;
+                    if (i < firstRoom[parity]) firstRoom[parity] = i;
+                    lanes[parity].flag(i);
+                }
+            }
+        }
 
-        while (block) {
-            Floor* floor = block->firstFloor;
-            while (floor) {
-                Room* room = floor->firstRoom;
-                while (room) {
-                    // Column-major traversal
-                    for (int col = 0; col < gridSize; col++) {
-                        if (!matchesParity(batchID, col)) continue;
-
-                        for (int row = 0; row < gridSize; row++) {
-                            Seat* seat = room->getSeat(row, col);
-                            if (!seat) continue;
-
-                            if (!seat->student) {
-                                if (checkSubjectRestriction(room, batchID, subject)) {
-                                    if (outBlock) *outBlock = block;
-                                    if (outFloor) *outFloor = floor;
-                                    if (outRoom) *outRoom = room;
-                                    return seat;
-                                }
-                            }
-                            else if (rollNo < seat->student->rollNumber) {
-                                if (outBlock) *outBlock = block;
-                                if (outFloor) *outFloor = floor;
-                                if (outRoom) *outRoom = room;
-                                return seat;
-                            }
+        auto compact = [&](int parity) {
+            if (vacancies[parity] > 0) {
+                compactLane(parity, vacated, firstRoom[parity], vacancies[parity], &lanes[parity]);
+            }
+        };
+        forEachLane(compact);
+        runDeferredCollapses(lanes, 2);
+
+        delete[] vacated;
+        return vacancies[0] + vacancies[1];
+    }
+
+    // Multi-vacancy backward collapse over one lane. Vacancies queue up in
+    // traversal order; each occupied seat behind them is offered to the
+    // oldest one under the same parity, subject and roll-order rules as
+    // shiftBackward, and the seat it leaves joins the back of the queue.
+    void compactLane(int parity, const bool* vacated, int firstRoom, int vacancies,
+        LaneContext* lane) {
+        const int cap = rooms[0]->capacity();
+        Seat** queue = new Seat*[vacancies];
+        int head = 0;
+        int size = 0;
+        int lastPlacedRoll = -1;  // To maintain ascending roll order
+
+        for (int i = firstRoom; i < roomCount; i++) {
+            Room* rm = rooms[i];
+            for (int col = parity; col < side(); col += 2) {
+                for (int row = 0; row < side(); ++row) {
+                    Seat* seat = rm->getSeat(row, col);
+
+                    if (!seat->student) {
+                        if (vacated[i * cap + seat->lane]) {
+                            queue[(head + size++) % vacancies] = seat;
                         }
+                        continue;
                     }
-                    room = room->next;
+                    if (size == 0) continue;
+
+                    Seat* vacancy = queue[head];
+                    Student* donor = seat->student;
+                    Room* destRoom = rooms[vacancy->roomIndex];
+
+                    if (!matchesParity(donor->batchID, vacancy->col))
+                        continue;
+                    if (!checkSubjectRestriction(destRoom, donor->batchID, donor->subjectId))
+                        continue;
+                    if (!adjacencyAllows(vacancy, donor->subjectId, donor))
+                        continue;
+                    if (lastPlacedRoll != -1 && donor->rollNumber < lastPlacedRoll)
+                        continue;
+
+                    rm->setStudent(seat, nullptr);
+                    destRoom->setStudent(vacancy, donor);
+                    lastPlacedRoll = donor->rollNumber;
+                    flagForCollapse(rm, lane);
+
+                    head = (head + 1) % vacancies;
+                    queue[(head + size - 1) % vacancies] = seat;
                 }
-                floor = floor->next;
             }
-            block = block->next;
         }
-        return nullptr;
+        delete[] queue;
     }
 
-    // Connect vertical pointers (up/down)
-    void connectVertically() {
-        Block* block = firstBlock;
-        while (block) {
-            Floor* floor = block->firstFloor;
-            Floor* floorAbove = nullptr;
+    // Backward collapse body. Only the vacancy's parity columns can supply
+    // a donor, so the walk starts at its room and skips the other lane; it
+    // ends before lane->endRoom.
+    void shiftBackward(Seat* deletedSeat, LaneContext* lane) {
+        if (!deletedSeat) return;
 
-            while (floor) {
-                if (floorAbove) {
-                    Room* room = floor->firstRoom;
-                    Room* roomAbove = floorAbove->firstRoom;
+        BackwardWalk walk = { deletedSeat, deletedSeat, false, -1 };
+        continueBackward(walk, deletedSeat->roomIndex, lane->endRoom, lane);
+    }
 
-                    while (room && roomAbove) {
-                        for (int r = 0; r < gridSize; r++) {
-                            for (int c = 0; c < gridSize; c++) {
-                                Seat* seat = room->getSeat(r, c);
-                                Seat* seatAbove = roomAbove->getSeat(r, c);
-                                if (seat && seatAbove) {
-                                    seat->up = seatAbove;
-                                    seatAbove->down = seat;
-                                }
-                            }
+    // The backward walk over rooms [firstRoom, endRoom), picking up where
+    // 'walk' left off
+    void continueBackward(BackwardWalk& walk, int firstRoom, int endRoom, LaneContext* lane) {
+        Seat* deletedSeat = walk.deletedSeat;
+        Seat*& vacancy = walk.vacancy;
+        bool& foundDeleted = walk.foundDeleted;
+        int& lastPlacedRoll = walk.lastPlacedRoll;
+        int parity = deletedSeat->col % 2;
+
+        for (int i = firstRoom; i < endRoom; i++) {
+            if (i > deletedSeat->roomIndex && rooms[i]->laneOccupied[parity] == 0) continue;
+            Room* rm = ownRoom(rooms[i]);
+            for (int col = parity; col < side(); col += 2) {
+                for (int row = 0; row < side(); ++row) {
+                    Seat* seat = rm->getSeat(row, col);
+
+                    // Wait until the deleted seat is reached in order
+                    if (!foundDeleted) {
+                        if (seat == deletedSeat) {
+                            foundDeleted = true;
+                            if (seat->student)
+                                lastPlacedRoll = seat->student->rollNumber;
+                        }
+                        continue;
+                    }
+
+                    if (!seat->student) continue; // empty donor, skip
+                    Student* donor = seat->student;
+
+                    // Get destination room (vacancy's room)
+                    Room* destRoom = getRoomFromSeat(vacancy, nullptr, nullptr);
+                    if (!destRoom) continue;
+
+                    // 1️⃣ Parity check (odd/even batch-column rule)
+                    if (!matchesParity(donor->batchID, vacancy->col))
+                        continue;
+
+                    // 2️⃣ Subject restriction rule
+                    if (!checkSubjectRestriction(destRoom, donor->batchID, donor->subjectId))
+                        continue;
+                    if (!adjacencyAllows(vacancy, donor->subjectId, donor))
+                        continue;
+
+                    // 3️⃣ Ascending roll order check
+                    if (lastPlacedRoll != -1 && donor->rollNumber < lastPlacedRoll)
+                        continue;
+
+                    // ✅ All rules satisfied → perform backward shift
+                    // (setStudent keeps occupancy counts right when crossing rooms)
+                    rm->setStudent(seat, nullptr);
+                    destRoom->setStudent(vacancy, donor);
+                    lastPlacedRoll = donor->rollNumber;
+
+                    // If donor room underfilled → roomCollapse (once the walk is done)
+                    flagForCollapse(rm, lane);
+
+                    // Vacancy moves to donor’s seat → next loop continues
+                    vacancy = seat;
+                }
+            }
+        }
+        // When loop ends, no more valid donors exist.
+    }
+
+    // ---- Per-block scans, run in parallel and merged in block order ----
+
+    // Seating plan text for one block, as written by exportSeatingPlan
+    void writeBlockPlan(Block* block, std::ostream& out) {
+        Floor* floor = block->firstFloor;
+        while (floor) {
+            Room* room = floor->firstRoom;
+            while (room) {
+                out << "Block " << block->blockID.c_str() << " - Floor "
+                    << floor->floorNumber << " - Room " << room->roomNumber << "\n";
+
+                for (int r = 0; r < side(); r++) {
+                    for (int c = 0; c < side(); c++) {
+                        Seat* seat = room->getSeat(r, c);
+                        if (seat && seat->student) {
+                            out << "[" << seat->student->rollNumber << "] ";
+                        }
+                        else {
+                            out << "[Empty] ";
                         }
-                        room = room->next;
-                        roomAbove = roomAbove->next;
                     }
+                    out << "\n";
+                }
+                out << "\n";
+                room = room->next;
+            }
+            floor = floor->next;
+        }
+    }
+
+    // One room of the fixed-layout plan. Every cell is padded to the same
+    // width, so a room's section keeps its size and offset as students move.
+    void writeFixedRoom(Room* room, std::ostream& out) {
+        const int cellWidth = 14;   // "[-2147483648] " fits
+        Floor* floor = room->floor;
+        out << "Block " << floor->block->blockID.c_str() << " - Floor "
+            << floor->floorNumber << " - Room " << room->roomNumber << "\n";
+
+        char cell[cellWidth + 1];
+        for (int r = 0; r < side(); r++) {
+            for (int c = 0; c < side(); c++) {
+                Seat* seat = room->getSeat(r, c);
+                int n = seat->student ?
+                    std::snprintf(cell, sizeof(cell), "[%d]", seat->student->rollNumber) :
+                    std::snprintf(cell, sizeof(cell), "[Empty]");
+                while (n < cellWidth) cell[n++] = ' ';
+                out.write(cell, cellWidth);
+            }
+            out << "\n";
+        }
+        out << "\n";
+        room->dirty[0] = room->dirty[1] = false;
+    }
+
+    // Roster lines for one block, as written by saveToFile
+    void writeBlockRoster(Block* block, std::ostream& out) {
+        Floor* floor = block->firstFloor;
+        while (floor) {
+            Room* room = floor->firstRoom;
+            while (room) {
+                for (int r = 0; r < side(); r++) {
+                    for (int c = 0; c < side(); c++) {
+                        Seat* seat = room->getSeat(r, c);
+                        if (seat && seat->student) {
+                            out << seat->student->rollNumber << " "
+                                << seat->student->batchID << " "
+                                << seat->student->subject << "\n";
+                        }
+                    }
+                }
+                room = room->next;
+            }
+            floor = floor->next;
+        }
+    }
+
+    // ---- Journal and snapshot helpers ----
+
+    void attachJournal(SeatJournal* target) {
+        journal = target;
+        for (int i = 0; i < roomCount; i++) rooms[i]->journal = target;
+    }
+
+    void detachJournal() {
+        SeatJournal* old = journal;
+        attachJournal(nullptr);
+        if (old) {
+            old->commit();
+            delete old;
+        }
+    }
+
+    // Snapshot of every occupied seat, written and synced beside the live
+    // file and renamed over it, then a fresh journal. Returns false on an
+    // I/O error.
+    bool writeCheckpoint() {
+        detachJournal();
+
+        int length = snapshotPath.length();
+        char* temp = new char[length + 5];
+        const char* path = snapshotPath.c_str();
+        for (int i = 0; i < length; i++) temp[i] = path[i];
+        temp[length] = '.';
+        temp[length + 1] = 't';
+        temp[length + 2] = 'm';
+        temp[length + 3] = 'p';
+        temp[length + 4] = '\0';
+
+        bool ok;
+        {
+            SeatJournal snapshot(temp, &subjects, roomCount, rooms[0]->capacity());
+            const int cap = rooms[0]->capacity();
+            for (int i = 0; i < roomCount; i++) {
+                for (int pos = 0; pos < cap; pos++) {
+                    Seat* seat = rooms[i]->seatAtLane(pos);
+                    if (seat->student) snapshot.recordSeat(i * cap + pos, seat->student);
+                }
+            }
+            ok = snapshot.commit();
+        }
+        if (ok && std::rename(temp, path) != 0) {
+            std::remove(path);
+            ok = std::rename(temp, path) == 0;
+        }
+        if (ok) ok = SeatJournal::syncDirectoryOf(path);
+        delete[] temp;
+        if (!ok) return false;
+
+        SeatJournal* fresh = new SeatJournal(journalPath.c_str(), &subjects,
+            roomCount, rooms[0]->capacity());
+        if (!fresh->isOpen()) {
+            delete fresh;
+            return false;
+        }
+        attachJournal(fresh);
+        return true;
+    }
+
+    // Called as the outermost mutator returns
+    void commitJournal() {
+        if (!journal->commit()) std::cout << "Error: Journal could not be synced to disk!\n";
+        if (checkpointEvery > 0 && journal->size() >= checkpointEvery && !writeCheckpoint()) {
+            std::cout << "Error: Checkpoint failed; journaling stopped.\n";
+        }
+    }
+
+    // Empty the building in place: seats, counters, indexes, cursors and
+    // undo logs are cleared and both student pools are taken back whole.
+    // Nothing is journaled and no collapse runs.
+    void clearSession() {
+        for (int i = 0; i < roomCount; i++) {
+            if (rooms[i]->origin) unshareRoom(rooms[i], false);
+            rooms[i]->vacateAll();
+        }
+        for (int b = 0; b < totalBlocks; b++) {
+            blocks[b]->occupancy.clear();
+            for (Floor* floor = blocks[b]->firstFloor; floor; floor = floor->next) {
+                floor->occupancy.clear();
+            }
+        }
+        occupancy.clear();
+        students.clear();
+        for (int lane = 0; lane < 2; lane++) {
+            undo[lane].discard();
+            pools[lane].reset();
+            cursors[lane] = LaneCursor();
+        }
+    }
+
+    // Apply a snapshot or journal file seat by seat. Returns the number of
+    // records applied, or -1 if the file is missing or was written for a
+    // building of a different shape.
+    int replayJournal(const char* path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return -1;
+
+        const int cap = rooms[0]->capacity();
+        JournalRecord record;
+        if (!SeatJournal::read(in, record) || record.kind != JournalHeader ||
+            record.seat != roomCount || record.rollNo != cap) {
+            return -1;
+        }
+
+        int* subjectMap = nullptr;     // journal subject id -> id in this system
+        int mapSize = 0;
+        int applied = 0;
+        while (SeatJournal::read(in, record)) {
+            if (record.kind == JournalSubject) {
+                if (record.seat < 0 || record.rollNo < 0) break;
+                char* name = new char[record.rollNo + 1];
+                in.read(name, record.rollNo);
+                name[record.rollNo] = '\0';
+                if (in.gcount() != record.rollNo) {
+                    delete[] name;
+                    break;
+                }
+                if (record.seat >= mapSize) {
+                    int newSize = record.seat + 8;
+                    int* grown = new int[newSize];
+                    for (int i = 0; i < newSize; i++) grown[i] = i < mapSize ? subjectMap[i] : kVacantSubject;
+                    delete[] subjectMap;
+                    subjectMap = grown;
+                    mapSize = newSize;
+                }
+                subjectMap[record.seat] = subjects.intern(name);
+                delete[] name;
+                applied++;
+                continue;
+            }
+
+            if (record.seat < 0 || record.seat >= roomCount * cap) break;
+            Room* room = rooms[record.seat / cap];
+            Seat* seat = room->seatAtLane(record.seat % cap);
+            Student* removed = seat->student;
+            if (removed) {
+                room->setStudent(seat, nullptr);
+                retire(removed);
+            }
+            if (record.kind == JournalPlace) {
+                int subjectId = record.subjectId >= 0 && record.subjectId < mapSize ?
+                    subjectMap[record.subjectId] : kVacantSubject;
+                Student* student = pools[record.batchID & 1].allocate(record.rollNo,
+                    record.batchID, subjects.name(subjectId), subjectId);
+                room->setStudent(seat, student);
+                admit(student);
+            }
+            applied++;
+        }
+        delete[] subjectMap;
+        return applied;
+    }
+
+    // Seated students outside the batch counters (placed by forwardCollapse
+    // with a batch outside 22-25)
+    int unindexedStudents() {
+        int seated = 0;
+        for (int i = 0; i < roomCount; i++) seated += rooms[i]->occupiedSeats();
+        return seated - occupancy.total();
+    }
+
+    // Body of footprint(). Seats and lanes a clone still shares count for
+    // the system that owns them, not for the clone.
+    Footprint measureFootprint() {
+        Footprint usage;
+        int floorCount = 0;
+        for (int i = 0; i < totalBlocks; i++) floorCount += blocks[i]->totalFloors;
+        usage.add(Footprint::Blocks, totalBlocks, static_cast<long long>(totalBlocks) * sizeof(Block));
+        usage.add(Footprint::Floors, floorCount, static_cast<long long>(floorCount) * sizeof(Floor));
+
+        for (int i = 0; i < roomCount; i++) {
+            Room* room = rooms[i];
+            const int cap = room->capacity();
+            long long roomBytes = sizeof(Room);
+            if (room->adjacent) roomBytes += static_cast<long long>(cap) * sizeof(int);
+            if (room->grid && !room->origin) {
+                usage.add(Footprint::Seats, cap, static_cast<long long>(cap) * sizeof(Seat));
+                if (room->lanes != room->laneStore) roomBytes += 3LL * cap * sizeof(int);
+            }
+            usage.add(Footprint::Rooms, 1, roomBytes);
+        }
+
+        usage.add(Footprint::Students, pools[0].reserved() + pools[1].reserved(),
+            pools[0].bytes() + pools[1].bytes());
+        usage.add(Footprint::Subjects, subjects.size(), subjects.bytes());
+
+        // Objects counted for the indexes are the students they hold
+        long long indexBytes = students.bytes() +
+            static_cast<long long>(roomCount) * sizeof(Room*) +
+            static_cast<long long>(totalBlocks) * sizeof(Block*);
+        if (planOffsets) indexBytes += static_cast<long long>(roomCount) * sizeof(std::streamoff);
+        usage.add(Footprint::Indexes, students.lane(0).size() + students.lane(1).size(), indexBytes);
+
+        long long otherBytes = sizeof(*this) + undo[0].bytes() + undo[1].bytes() + search.bytes();
+        if (journal) otherBytes += sizeof(SeatJournal);
+        usage.add(Footprint::Other, 1, otherBytes);
+        return usage;
+    }
+
+    // Same-subject pairs directly in front, behind or beside each other
+    int adjacentPairs() {
+        int counted = 0;
+        for (int i = 0; i < roomCount; i++) {
+            if (!rooms[i]->adjacent) continue;
+            for (int pos = 0; pos < rooms[i]->capacity(); pos++) counted += rooms[i]->adjacent[pos];
+        }
+        return counted / 2;
+    }
+
+    void printSeatId(int seatId) {
+        const int cap = rooms[0]->capacity();
+        Room* room = rooms[seatId / cap];
+        Seat* seat = room->seatAtLane(seatId % cap);
+        std::cout << "Block " << room->floor->block->blockID.c_str() << ", Floor "
+            << room->floor->floorNumber << ", Room " << room->roomNumber
+            << ", Row " << seat->row << ", Col " << seat->col;
+    }
+
+    // Index row for a seated student
+    StudentRecord recordOf(Student* student) {
+        Seat* seat = student->seat;
+        Room* room = rooms[seat->roomIndex];
+        StudentRecord record = { student->rollNumber, student->batchID, student->subjectId,
+            room->floor->block->blockID.c_str(), room->floor->floorNumber, room->roomNumber,
+            seat->row, seat->col };
+        return record;
+    }
+
+    // Merge the roll-ordered ranges [from, to) of several index lists into
+    // one span; cost is the size of the result times the number of lists
+    RecordSpan mergeRecords(const StudentList** lists, int* from, const int* to, int listCount) {
+        int total = 0;
+        for (int i = 0; i < listCount; i++) total += to[i] - from[i];
+        StudentRecord* rows = total > 0 ? new StudentRecord[total] : nullptr;
+
+        for (int n = 0; n < total; n++) {
+            int best = -1;
+            for (int i = 0; i < listCount; i++) {
+                if (from[i] < to[i] && (best < 0 ||
+                    lists[i]->at(from[i])->rollNumber < lists[best]->at(from[best])->rollNumber)) {
+                    best = i;
                 }
-                floorAbove = floor;
-                floor = floor->next;
             }
-            block = block->next;
+            rows[n] = recordOf(lists[best]->at(from[best]++));
         }
+        return RecordSpan(rows, total);
     }
 
-    // Connect cross-block pointers
-    void connectCrossBlock() {
-        Block* block = firstBlock;
-        while (block && block->next) {
-            Block* nextBlock = block->next;
+    // What checkBlockIntegrity found in one block besides its messages
+    struct IntegrityTally {
+        int errors;
+        int seated;         // students found in the seats
+        int indexed;        // of those, the ones this system's index should hold
+        int inversions;     // students seated after a larger roll of their lane
+        int crowded;        // rooms where a batch past half its lane mixes subjects
+        int firstRoll[2];   // first and last seated roll of each lane, to carry
+        int lastRoll[2];    // the roll order check across block boundaries
+
+        IntegrityTally() : errors(0), seated(0), indexed(0), inversions(0), crowded(0) {
+            firstRoll[0] = firstRoll[1] = lastRoll[0] = lastRoll[1] = kVacantRoll;
+        }
+    };
 
-            Floor* floor1 = block->firstFloor;
-            Floor* floor2 = nextBlock->firstFloor;
+    // Start of a message about the seat at row 'r', column 'c' of 'room'
+    std::ostream& seatError(std::ostream& out, Room* room, int r, int c) {
+        return out << "Error: Block " << room->floor->block->blockID.c_str() << ", Floor "
+            << room->floor->floorNumber << ", Room " << room->roomNumber << ", Row " << r
+            << ", Col " << c << ": ";
+    }
 
-            while (floor1 && floor2) {
-                Room* room1 = floor1->firstRoom;
-                Room* room2 = floor2->firstRoom;
+    // Integrity of one block in a single pass over its seats, in traversal
+    // order: linkage, seat links (each must lead back), lane entries,
+    // parity, occupancy and adjacency counts. Roll order and the subject
+    // limit are only tallied; see validateIntegrity.
+    void checkBlockIntegrity(Block* block, std::ostream& out, IntegrityTally& tally) {
+        static Seat* Seat::* const links[8] = { &Seat::front, &Seat::back, &Seat::left,
+            &Seat::right, &Seat::up, &Seat::down, &Seat::leftBuilding, &Seat::rightBuilding };
+        static const char* const linkNames[8] = { "front", "back", "left", "right", "up",
+            "down", "left building", "right building" };
+
+        const int g = side();
+        const int maxParitySeats = (g * g) / 2;
+        if (block->next && block->next->prev != block) {
+            out << "Error: Block linkage broken!\n";
+            tally.errors++;
+        }
 
-                while (room1 && room2) {
-                    for (int r = 0; r < gridSize; r++) {
-                        Seat* rightmost = room1->getSeat(r, gridSize - 1);
-                        Seat* leftmost = room2->getSeat(r, 0);
+        int blockSeats[kBatchCount] = {};
+        Floor* floor = block->firstFloor;
+        while (floor) {
+            if (floor->next && floor->next->prev != floor) {
+                out << "Error: Floor linkage broken!\n";
+                tally.errors++;
+            }
 
-                        if (rightmost && leftmost) {
-                            rightmost->rightBuilding = leftmost;
-                            leftmost->leftBuilding = rightmost;
-                        }
-                    }
-                    room1 = room1->next;
-                    room2 = room2->next;
+            int floorSeats[kBatchCount] = {};
+            Room* room = floor->firstRoom;
+            while (room) {
+                if (room->next && room->next->prev != room) {
+                    out << "Error: Room linkage broken!\n";
+                    tally.errors++;
+                }
+                if (!room->grid) {
+                    out << "Error: Room " << room->roomNumber << " has no seats!\n";
+                    tally.errors++;
+                    room = room->next;
+                    continue;
                 }
-                floor1 = floor1->next;
-                floor2 = floor2->next;
-            }
-            block = block->next;
-        }
-    }
 
-    // Connect floor continuity
-    void connectFloorContinuity() {
-        Block* block = firstBlock;
-        while (block) {
-            Floor* floor = block->firstFloor;
-            while (floor && floor->next) {
-                Room* lastRoom = floor->lastRoom;
-                Room* firstRoomNext = floor->next->firstRoom;
+                int batchSeats[kBatchCount] = {};
+                int batchSubject[kBatchCount];
+                bool mixed[kBatchCount] = {};
+                for (int p = 0; p < 2; p++) {
+                    const int* rolls = room->laneRolls(p);
+                    const int* batches = room->laneBatches(p);
+                    const int* subjectIds = room->laneSubjects(p);
+                    int laneSeated = 0;
+
+                    for (int i = 0; i < room->laneLength(p); i++) {
+                        Seat* seat = room->laneSeat(p, i);
+                        int r = i % g;
+                        int c = p + 2 * (i / g);
+                        if (seat->row != r || seat->col != c || seat->roomIndex != room->index ||
+                            seat->lane != room->laneOffset(p) + i) {
+                            seatError(out, room, r, c) << "seat labelled (" << seat->row << ","
+                                << seat->col << ") of room " << seat->roomIndex << "!\n";
+                            tally.errors++;
+                        }
 
-                if (lastRoom && firstRoomNext) {
-                    for (int r = 0; r < gridSize; r++) {
-                        Seat* lastCol = lastRoom->getSeat(r, gridSize - 1);
-                        Seat* firstCol = firstRoomNext->getSeat(r, 0);
+                        // Rooms a clone still shares link into its source,
+                        // so only links between owned rooms must lead back
+                        bool inside[4] = { r > 0, r < g - 1, c > 0, c < g - 1 };
+                        for (int d = 0; d < 8; d++) {
+                            Seat* target = seat->*links[d];
+                            if (!target) {
+                                if (d < 4 && inside[d]) {
+                                    seatError(out, room, r, c) << "no " << linkNames[d] << " link!\n";
+                                    tally.errors++;
+                                }
+                                continue;
+                            }
+                            if (target->roomIndex < 0 || target->roomIndex >= roomCount) {
+                                seatError(out, room, r, c) << linkNames[d]
+                                    << " link leads outside the building!\n";
+                                tally.errors++;
+                                continue;
+                            }
+                            Room* other = rooms[target->roomIndex];
+                            if (room->origin || other->origin) continue;
+                            if (target < other->grid || target >= other->grid + other->capacity() ||
+                                target->*links[d ^ 1] != seat) {
+                                seatError(out, room, r, c) << linkNames[d]
+                                    << " link does not lead back!\n";
+                                tally.errors++;
+                            }
+                        }
 
-                        if (lastCol && firstCol) {
-                            lastCol->right = firstCol;
-                            firstCol->left = lastCol;
+                        Student* student = seat->student;
+                        if (!student) {
+                            if (rolls[i] != kVacantRoll) {
+                                seatError(out, room, r, c) << "vacant seat has roll "
+                                    << rolls[i] << " in its lane!\n";
+                                tally.errors++;
+                            }
+                            continue;
+                        }
+                        laneSeated++;
+                        if (student->seat != seat) {
+                            seatError(out, room, r, c) << "roll " << student->rollNumber
+                                << " does not point back at its seat!\n";
+                            tally.errors++;
+                        }
+                        if (rolls[i] != student->rollNumber || batches[i] != student->batchID ||
+                            subjectIds[i] != student->subjectId) {
+                            seatError(out, room, r, c) << "lane entry differs from roll "
+                                << student->rollNumber << "!\n";
+                            tally.errors++;
+                        }
+                        if (!matchesParity(student->batchID, c)) {
+                            seatError(out, room, r, c) << "batch " << student->batchID
+                                << " in a column of the wrong parity!\n";
+                            tally.errors++;
                         }
-                    }
-                }
-                floor = floor->next;
-            }
 
-            // Connect top floor of current block to bottom floor of next block
-            if (block->next) {
-                Room* topLastRoom = block->lastFloor->lastRoom;
-                Room* nextBottomFirst = block->next->firstFloor->firstRoom;
+                        if (student->rollNumber < tally.lastRoll[p]) tally.inversions++;
+                        if (tally.firstRoll[p] == kVacantRoll) tally.firstRoll[p] = student->rollNumber;
+                        tally.lastRoll[p] = student->rollNumber;
 
-                if (topLastRoom && nextBottomFirst) {
-                    for (int r = 0; r < gridSize; r++) {
-                        Seat* lastSeat = topLastRoom->getSeat(r, gridSize - 1);
-                        Seat* firstSeat = nextBottomFirst->getSeat(r, 0);
+                        int b = student->batchID - kFirstBatch;
+                        if (b >= 0 && b < kBatchCount) {
+                            if (!batchSeats[b]) batchSubject[b] = student->subjectId;
+                            else if (batchSubject[b] != student->subjectId) mixed[b] = true;
+                            batchSeats[b]++;
+                        }
 
-                        if (lastSeat && firstSeat) {
-                            lastSeat->right = firstSeat;
-                            firstSeat->left = lastSeat;
+                        if (room->adjacent) {
+                            int expected = 0;
+                            Seat* near[4] = { seat->front, seat->back, seat->left, seat->right };
+                            for (int d = 0; d < 4; d++) {
+                                Seat* other = near[d];
+                                if (other && other->roomIndex == seat->roomIndex && other->student &&
+                                    other->student->subjectId == student->subjectId) {
+                                    expected++;
+                                }
+                            }
+                            if (room->adjacent[seat->lane] != expected) {
+                                seatError(out, room, r, c) << "adjacency count is "
+                                    << room->adjacent[seat->lane] << ", neighbours give "
+                                    << expected << "!\n";
+                                tally.errors++;
+                            }
                         }
                     }
+
+                    if (room->laneOccupied[p] != laneSeated) {
+                        out << "Error: Room " << room->roomNumber << " of Block "
+                            << block->blockID.c_str() << ", Floor " << floor->floorNumber
+                            << " counts " << room->laneOccupied[p] << " students in its "
+                            << (p ? "odd" : "even") << " columns, seats hold " << laneSeated << "!\n";
+                        tally.errors++;
+                    }
+                    tally.seated += laneSeated;
                 }
+
+                for (int b = 0; b < kBatchCount; b++) {
+                    if (mixed[b] && batchSeats[b] > maxParitySeats / 2) tally.crowded++;
+                    if (!room->origin) tally.indexed += batchSeats[b];
+                    floorSeats[b] += batchSeats[b];
+                }
+                room = room->next;
+            }
+
+            for (int b = 0; b < kBatchCount; b++) {
+                if (floor->occupancy.batchSeats[b] != floorSeats[b]) {
+                    out << "Error: Floor " << floor->floorNumber << " of Block "
+                        << block->blockID.c_str() << " counts " << floor->occupancy.batchSeats[b]
+                        << " students of batch " << kFirstBatch + b << ", seats hold "
+                        << floorSeats[b] << "!\n";
+                    tally.errors++;
+                }
+                blockSeats[b] += floorSeats[b];
+            }
+            floor = floor->next;
+        }
+
+        for (int b = 0; b < kBatchCount; b++) {
+            if (block->occupancy.batchSeats[b] != blockSeats[b]) {
+                out << "Error: Block " << block->blockID.c_str() << " counts "
+                    << block->occupancy.batchSeats[b] << " students of batch " << kFirstBatch + b
+                    << ", seats hold " << blockSeats[b] << "!\n";
+                tally.errors++;
             }
-            block = block->next;
         }
     }
 
-public:
-    SeatingSystem() : firstBlock(nullptr), lastBlock(nullptr), gridSize(4), totalBlocks(0) {}
+    // Render every block into its own buffer on the shared pool, then
+    // stream the buffers out in block order
+    template <class Render>
+    void writeBlocksInOrder(std::ostream& out, Render render) {
+        TextStream* parts = new TextStream[totalBlocks];
+        auto task = [&](int i) { render(i, parts[i]); };
+        sharedPool().parallelFor(totalBlocks, task);
+        for (int i = 0; i < totalBlocks; i++) parts[i].writeTo(out);
+        delete[] parts;
+    }
 
-    SeatingSystem(int numBlocks, int floorsPerBlock, int roomsPerFloor, int gridSize)
-        : firstBlock(nullptr), lastBlock(nullptr), gridSize(gridSize), totalBlocks(numBlocks) {
+    // Run a batch through 'apply' on one clone and through insertStudent
+    // and deleteStudent on another, and list the seats where they differ
+    template <class Apply>
+    int replayDifferences(const LaneOp* ops, int count, const char* engine, Apply apply) {
+        BasicSeatingSystem* batched = clone();
+        BasicSeatingSystem* serial = clone();
+        apply(batched);
+        for (int i = 0; i < count; i++) {
+            if (ops[i].kind == LaneOp::Insert) serial->insertStudent(ops[i].rollNo, ops[i].batchID, ops[i].subject);
+            else serial->deleteStudent(ops[i].rollNo);
+        }
 
-        char blockIDs[3] = { 'A', 'B', 'C' };
-        Block* prevBlock = nullptr;
+        int differences = batched->planDifferences(*serial, false);
+        if (differences > 0) {
+            std::cout << "Error: " << engine << " leaves " << differences
+                << " seats unlike the ops run one at a time!\n";
+            batched->planDifferences(*serial, true);
+        }
+        delete batched;
+        delete serial;
+        return differences;
+    }
 
-        for (int i = 0; i < numBlocks; i++) {
-            Block* block = new Block(blockIDs[i], floorsPerBlock, roomsPerFloor, gridSize);
+public:
+    BasicSeatingSystem() : firstBlock(nullptr), lastBlock(nullptr), gridSize(N > 0 ? N : 4), totalBlocks(0),
+        blocks(nullptr), rooms(nullptr), roomCount(0), inTransaction(false), adjacencyRule(false),
+        sharedRooms(0), sharedOut(0), journal(nullptr), checkpointEvery(0), planOffsets(nullptr),
+        writerThread(std::thread::id()) {
+    }
 
-            if (!firstBlock) firstBlock = block;
-            if (prevBlock) {
-                prevBlock->next = block;
-                block->prev = prevBlock;
-            }
-            prevBlock = block;
+    BasicSeatingSystem(int numBlocks, int floorsPerBlock, int roomsPerFloor, int gridSize)
+        : firstBlock(nullptr), lastBlock(nullptr), gridSize(N > 0 ? N : gridSize), totalBlocks(numBlocks),
+        blocks(nullptr), rooms(nullptr), roomCount(0), inTransaction(false), adjacencyRule(false),
+        sharedRooms(0), sharedOut(0), journal(nullptr), checkpointEvery(0), planOffsets(nullptr),
+        writerThread(std::thread::id()) {
+        if (N > 0 && gridSize != N) {
+            std::cout << "Grid size is fixed at " << N << " for this system.\n";
         }
-        lastBlock = prevBlock;
+        build(floorsPerBlock, roomsPerFloor);
+    }
 
-        connectVertically();
-        connectCrossBlock();
-        connectFloorContinuity();
+    // Blocks named by the caller, e.g. { "101", "102", "Annex" }, in traversal order
+    BasicSeatingSystem(const char* const* blockIDs, int numBlocks, int floorsPerBlock,
+        int roomsPerFloor, int gridSize)
+        : firstBlock(nullptr), lastBlock(nullptr), gridSize(N > 0 ? N : gridSize),
+        totalBlocks(numBlocks),
+        blocks(nullptr), rooms(nullptr), roomCount(0), inTransaction(false), adjacencyRule(false),
+        sharedRooms(0), sharedOut(0), journal(nullptr), checkpointEvery(0), planOffsets(nullptr),
+        writerThread(std::thread::id()) {
+        if (N > 0 && gridSize != N) {
+            std::cout << "Grid size is fixed at " << N << " for this system.\n";
+        }
+        build(floorsPerBlock, roomsPerFloor, blockIDs);
+    }
+
+    // Fixed-size systems take their grid size from the template argument
+    BasicSeatingSystem(int numBlocks, int floorsPerBlock, int roomsPerFloor)
+        : firstBlock(nullptr), lastBlock(nullptr), gridSize(N > 0 ? N : 4), totalBlocks(numBlocks),
+        blocks(nullptr), rooms(nullptr), roomCount(0), inTransaction(false), adjacencyRule(false),
+        sharedRooms(0), sharedOut(0), journal(nullptr), checkpointEvery(0), planOffsets(nullptr),
+        writerThread(std::thread::id()) {
+        build(floorsPerBlock, roomsPerFloor);
     }
 
-    ~SeatingSystem() {
+    ~BasicSeatingSystem() {
+        for (int i = 0; i < roomCount; i++) {
+            rooms[i]->releaseSharers();
+            leaveOrigin(rooms[i]);
+        }
+        commitUndo();
+        if (journal) {
+            journal->commit();
+            delete journal;
+        }
         Block* current = firstBlock;
         while (current) {
             Block* temp = current;
             current = current->next;
             delete temp;
         }
+        delete[] rooms;
+        delete[] blocks;
+        delete[] planOffsets;
     }
 
-    // Insert student
-    void insertStudent(int rollNo, int batchID, const char* subject) {
-        if (batchID < 22 || batchID > 25) {
-            std::cout << "Invalid batch ID! Must be 22-25.\n";
+    // Clear every assignment for a new exam session. The seats and their
+    // links stay wired and student records go back to their pools in one
+    // step; with journaling on, the journal restarts from an empty checkpoint.
+    void reset() {
+        WriteGuard guard(this);
+        if (inTransaction) {
+            std::cout << "Error: Cannot reset inside a transaction!\n";
             return;
         }
+        clearSession();
+        if (journal && !writeCheckpoint()) {
+            std::cout << "Error: Checkpoint failed; journaling stopped.\n";
+        }
+        std::cout << "Seating system reset.\n";
+    }
 
-        Block* targetBlock = nullptr;
-        Floor* targetFloor = nullptr;
-        Room* targetRoom = nullptr;
+    // Fork the plan for what-if planning; the caller deletes the copy. The
+    // copy shares every room with this system copy-on-write, so forking
+    // costs O(rooms) and a room is copied, seats and student records, only
+    // when either side first writes it (index queries and whole-building
+    // operations on the copy take their copies up front). A plan and its
+    // clones share seats, so drive them from one thread at a time.
+    BasicSeatingSystem* clone() {
+        WriteGuard guard(this);
+        BasicSeatingSystem* copy = new BasicSeatingSystem();
+        copy->gridSize = gridSize;
+        copy->totalBlocks = totalBlocks;
+
+        for (Block* source = firstBlock; source; source = source->next) {
+            int roomsPerFloor = source->firstFloor ? source->firstFloor->totalRooms : 0;
+            Block* block = new Block(source->blockID.c_str(), source->totalFloors, roomsPerFloor,
+                side(), false);
+            block->occupancy.assign(source->occupancy);
+            Floor* floor = block->firstFloor;
+            for (Floor* from = source->firstFloor; from; from = from->next) {
+                floor->occupancy.assign(from->occupancy);
+                floor = floor->next;
+            }
 
-        Seat* targetSeat = findInsertionPosition(rollNo, batchID, subject,
-            &targetBlock, &targetFloor, &targetRoom);
+            if (!copy->firstBlock) copy->firstBlock = block;
+            if (copy->lastBlock) {
+                copy->lastBlock->next = block;
+                block->prev = copy->lastBlock;
+            }
+            copy->lastBlock = block;
+        }
+        copy->indexRooms();
+
+        for (int i = 0; i < roomCount; i++) copy->shareRoom(copy->rooms[i], rooms[i]);
+        copy->adjacencyRule = adjacencyRule;
+        for (int i = 0; adjacencyRule && i < roomCount; i++) {
+            const int cap = rooms[i]->capacity();
+            copy->rooms[i]->adjacent = new int[cap];
+            for (int pos = 0; pos < cap; pos++) copy->rooms[i]->adjacent[pos] = rooms[i]->adjacent[pos];
+        }
+        for (int id = 0; id < subjects.size(); id++) copy->subjects.intern(subjects.name(id));
+        copy->occupancy.assign(occupancy);
+        copy->cursors[0] = cursors[0];
+        copy->cursors[1] = cursors[1];
+        return copy;
+    }
 
-        if (!targetSeat) {
-            std::cout << "Cannot insert student - all seats full or constraints violated!\n";
+    // Turn the adjacency rule on or off: no two students of a subject
+    // directly in front of, behind or beside each other in a room. Turning
+    // it on counts the pairs already seated; from then on placements and
+    // collapse moves keep such students apart, and each seat change
+    // updates the counts of its four neighbours only.
+    void setAdjacencyRule(bool on) {
+        WriteGuard guard(this);
+        adjacencyRule = on;
+        for (int i = 0; i < roomCount; i++) rooms[i]->trackAdjacency(on);
+        if (on) std::cout << "Adjacency rule on; " << adjacentPairs() << " pairs already seated.\n";
+        else std::cout << "Adjacency rule off.\n";
+    }
+
+    // Same-subject pairs seated next to each other (0 while the rule is off)
+    int adjacencyConflicts() {
+        ReadGuard guard(this);
+        return adjacentPairs();
+    }
+
+    // Group the following mutations into one transaction. The calling thread
+    // holds the write lock until commitTransaction or rollbackTransaction;
+    // rollback undoes every seat change in reverse, in time proportional
+    // to the number of changes.
+    void beginTransaction() {
+        if (writerThread.load() == std::this_thread::get_id()) {
+            std::cout << "Error: Transaction already open or writer busy on this thread!\n";
             return;
         }
+        writerLock.lock();
+        rwLock.lock();
+        writerThread.store(std::this_thread::get_id());
+        inTransaction = true;
+    }
 
-        Student* newStudent = new Student(rollNo, batchID, subject);
+    // Keep every change made since beginTransaction
+    void commitTransaction() {
+        if (!inTransaction || writerThread.load() != std::this_thread::get_id()) {
+            std::cout << "Error: No open transaction on this thread!\n";
+            return;
+        }
+        endTransaction();
+    }
 
-        if (!targetSeat->student) {
-            targetSeat->student = newStudent;
-            if (targetRoom) targetRoom->occupiedSeats++;
-            std::cout << "Student " << rollNo << " inserted successfully.\n";
+    // Undo every change made since beginTransaction
+    void rollbackTransaction() {
+        if (!inTransaction || writerThread.load() != std::this_thread::get_id()) {
+            std::cout << "Error: No open transaction on this thread!\n";
+            return;
         }
-        else {
-            forwardCollapse(targetSeat, newStudent, targetRoom);
+        UndoLog::Mark start = { 0, 0, 0 };
+        rollbackTo(0, start);
+        rollbackTo(1, start);
+        endTransaction();
+    }
+
+    // Insert student
+    void insertStudent(int rollNo, int batchID, const char* subject) {
+        WriteGuard guard(this);
+        if (batchID < 22 || batchID > 25) {
+            std::cout << "Invalid batch ID! Must be 22-25.\n";
+            return;
+        }
+
+        switch (placeStudent(rollNo, batchID, subjects.intern(subject))) {
+        case PlacedInVacancy:
+            std::cout << "Student " << rollNo << " inserted successfully.\n";
+            break;
+        case NoSeat:
+            std::cout << "Cannot insert student - all seats full or constraints violated!\n";
+            break;
+        case ShiftFailed:
+            std::cout << "Error: Cannot complete insertion!\n";
+            break;
+        case PlacedByShift:
+            break;
         }
     }
 
     // Forward collapse
     void forwardCollapse(Seat* startSeat, Student* newStudent, Room* startRoom) {
+        WriteGuard guard(this);
         if (!startSeat || !newStudent) return;
-
-        if (!startSeat->student) {
-            startSeat->student = newStudent;
-            if (startRoom) startRoom->occupiedSeats++;
-            return;
+        startSeat = ownSeat(rooms[startSeat->roomIndex], startSeat);
+
+        // Students live in the system's pools; take over the caller's record
+        int subjectId = subjects.intern(newStudent->subject);
+        Student* student = pools[newStudent->batchID & 1].allocate(newStudent->rollNumber,
+            newStudent->batchID, subjects.name(subjectId), subjectId);
+        delete newStudent;
+
+        int lane = startSeat->col % 2;
+        UndoLog::Mark mark = undo[lane].mark();
+        if (!shiftForward(startSeat, student, startRoom)) {
+            rollbackTo(lane, mark);
+            pools[student->batchID & 1].release(student);
+            std::cout << "Error: Cannot complete insertion!\n";
+        }
+        else {
+            admit(student);
         }
+    }
 
-        Student* displaced = startSeat->student;
-        startSeat->student = newStudent;
+    // Delete student
+    bool deleteStudent(int rollNo) {
+        WriteGuard guard(this);
+        if (!removeStudent(rollNo, -1, nullptr)) {
+            std::cout << "Student not found.\n";
+            return false;
+        }
+        std::cout << "Student " << rollNo << " deleted successfully.\n";
+        return true;
+    }
 
-        Block* block = nullptr;
-        Floor* floor = nullptr;
-        Room* room = nullptr;
+    void backwardCollapse(Seat* deletedSeat, Room* /*roomParam*/) {
+        WriteGuard guard(this);
+        if (!deletedSeat) return;
+        deletedSeat = ownSeat(rooms[deletedSeat->roomIndex], deletedSeat);
 
-        Seat* nextSeat = findInsertionPosition(displaced->rollNumber, displaced->batchID,
-            displaced->subject.c_str(), &block, &floor, &room);
+        LaneContext local(deletedSeat->col % 2, 0, roomCount);
+        shiftBackward(deletedSeat, &local);
+        runDeferredCollapses(&local, 1);
+    }
 
-        if (!nextSeat) {
-            std::cout << "Error: Cannot complete insertion!\n";
-            startSeat->student = displaced;
-            delete newStudent;
-            return;
+    // Delete several students at once. All seats are vacated first and then
+    // closed in a single compaction pass, instead of one backward collapse
+    // per student. Returns the number of students removed.
+    int deleteStudents(const int* rolls, int count) {
+        WriteGuard guard(this);
+        if (roomCount == 0 || count <= 0) return 0;
+
+        // Roll -> 0 while pending, 1 once deleted (first match only, as deleteStudent)
+        RollMap pending(count);
+        for (int i = 0; i < count; i++) pending.put(rolls[i], 0);
+
+        int removed = removeMatching([&](Student* student) {
+            if (pending.get(student->rollNumber) != 0) return false;
+            pending.put(student->rollNumber, 1);
+            return true;
+        });
+
+        int missing = 0;
+        for (int i = 0; i < count; i++) {
+            if (pending.get(rolls[i]) == 0) {
+                missing++;
+                pending.put(rolls[i], 1);
+            }
         }
 
-        forwardCollapse(nextSeat, displaced, room);
+        std::cout << "Deleted " << removed << " students.\n";
+        if (missing > 0) std::cout << missing << " roll numbers not found.\n";
+        return removed;
     }
 
-    // Delete student
-    bool deleteStudent(int rollNo) {
-        Block* block = firstBlock;
+    // Withdraw a whole batch
+    int deleteBatch(int batchID) {
+        WriteGuard guard(this);
+        if (roomCount == 0) return 0;
 
-        while (block) {
-            Floor* floor = block->firstFloor;
-            while (floor) {
-                Room* room = floor->firstRoom;
-                while (room) {
-                    for (int r = 0; r < gridSize; r++) {
-                        for (int c = 0; c < gridSize; c++) {
-                            Seat* seat = room->getSeat(r, c);
-                            if (seat && seat->student && seat->student->rollNumber == rollNo) {
-                                delete seat->student;
-                                seat->student = nullptr;
-                                room->occupiedSeats--;
+        int removed = removeMatching([&](Student* student) {
+            return student->batchID == batchID;
+        });
+        std::cout << "Deleted " << removed << " students of batch " << batchID << ".\n";
+        return removed;
+    }
 
-                                backwardCollapse(seat, room);
+    // Withdraw every student of a subject
+    int deleteSubject(const char* subject) {
+        WriteGuard guard(this);
+        int subjectId = subjects.find(subject);
+        if (roomCount == 0 || subjectId < 0) {
+            std::cout << "Deleted 0 students of " << subject << ".\n";
+            return 0;
+        }
 
-                                if (room->occupiedSeats < room->getMinOccupancy()) {
-                                    roomCollapse(room);
-                                }
+        int removed = removeMatching([&](Student* student) {
+            return student->subjectId == subjectId;
+        });
+        std::cout << "Deleted " << removed << " students of " << subject << ".\n";
+        return removed;
+    }
 
-                                std::cout << "Student " << rollNo << " deleted successfully.\n";
-                                return true;
-                            }
-                        }
-                    }
-                    room = room->next;
+    // Re-seat every student from scratch: one pass gathers and vacates each
+    // parity lane, a merge sort puts it in roll order, and the lane is packed
+    // from the first room on. Occupancy counts and lane cursors are rebuilt
+    // along the way. O(n log n); if the subject restriction leaves a lane
+    // without room, the building is restored as it was.
+    bool relayout() {
+        WriteGuard guard(this);
+        isolateRooms();
+        const int cap = rooms[0]->capacity();
+        Student** lanes[2];
+        int counts[2] = { 0, 0 };
+        UndoLog::Mark marks[2] = { undo[0].mark(), undo[1].mark() };
+        for (int parity = 0; parity < 2; parity++) {
+            lanes[parity] = new Student*[roomCount * cap];
+        }
+
+        for (int i = 0; i < roomCount; i++) {
+            Room* room = rooms[i];
+            for (int parity = 0; parity < 2; parity++) {
+                for (int pos = 0; pos < room->laneLength(parity); pos++) {
+                    Seat* seat = room->laneSeat(parity, pos);
+                    if (!seat->student) continue;
+                    lanes[parity][counts[parity]++] = seat->student;
+                    room->setStudent(seat, nullptr);
                 }
-                floor = floor->next;
             }
-            block = block->next;
+        }
+        cursors[0] = cursors[1] = LaneCursor();
+
+        bool packed[2];
+        auto pack = [&](int parity) {
+            sortByRoll(lanes[parity], counts[parity]);
+            packed[parity] = packLane(parity, lanes[parity], counts[parity]);
+        };
+        forEachLane(pack);
+
+        bool ok = packed[0] && packed[1];
+        if (!ok) {
+            rollbackTo(0, marks[0]);
+            rollbackTo(1, marks[1]);
+            std::cout << "Relayout failed: subject restrictions leave no room; seating unchanged.\n";
+        }
+        else {
+            int used = 0;
+            for (int i = 0; i < roomCount; i++) {
+                if (rooms[i]->occupiedSeats() > 0) used++;
+            }
+            std::cout << "Relayout: " << (counts[0] + counts[1]) << " students packed into "
+                << used << " rooms.\n";
         }
 
-        std::cout << "Student not found.\n";
-        return false;
+        delete[] lanes[0];
+        delete[] lanes[1];
+        return ok;
     }
-    void backwardCollapse(Seat* deletedSeat, Room* /*roomParam*/) {
-        if (!deletedSeat) return;
 
-        Seat* vacancy = deletedSeat;
-        bool foundDeleted = false;
-        int lastPlacedRoll = -1;  // To maintain ascending roll order
+    // Apply a batch of inserts and deletes with the odd and even parity lanes
+    // on separate threads. A batch's parity fixes its columns, and ordering,
+    // subject and collapse rules only ever compare students within one lane,
+    // so each lane replays its own ops in order and the seating matches
+    // serial execution. The adjacency rule compares neighbouring columns,
+    // so while it is on the ops run in order on this thread. A room collapse
+    // moves both lanes, so the batch is cut at each delete that leaves one
+    // of its rooms under-filled: ops after it are undone, the collapse runs
+    // as deleteStudent would run it, and the lanes resume past the delete.
+    // With 'totals', the placed, deleted and failed counts are added there
+    // instead of printed.
+    void applyInLanes(const LaneOp* ops, int count, int* totals = nullptr) {
+        WriteGuard guard(this);
+        isolateRooms();
+
+        // Route every op to a lane; deletes follow the latest insert of the
+        // same roll in this batch, else the student's current seat.
+        int* laneOf = new int[count];
+        int* subjectIds = new int[count];
+        RollMap recent(count);
+        int tally[3] = { 0, 0, 0 };     // placed, deleted, failed
+        for (int i = 0; i < count; i++) {
+            const LaneOp& op = ops[i];
+            laneOf[i] = -1;
+            if (op.kind == LaneOp::Insert) {
+                if (op.batchID < 22 || op.batchID > 25) {
+                    tally[2]++;
+                    continue;
+                }
+                subjectIds[i] = subjects.intern(op.subject);
+                laneOf[i] = parityOf(op.batchID);
+                recent.put(op.rollNo, laneOf[i]);
+            }
+            else {
+                laneOf[i] = recent.get(op.rollNo);
+                if (laneOf[i] < 0) {
+                    Room* room = nullptr;
+                    Seat* seat = findRollSeat(op.rollNo, -1, &room);
+                    if (seat) laneOf[i] = seat->col % 2;
+                }
+                if (laneOf[i] < 0) tally[2]++;
+            }
+        }
 
-        Block* block = firstBlock;
-        while (block) {
-            Floor* floor = block->firstFloor;
-            while (floor) {
-                Room* rm = floor->firstRoom;
-                while (rm) {
-                    for (int col = 0; col < gridSize; ++col) {
-                        for (int row = 0; row < gridSize; ++row) {
-                            Seat* seat = rm->getSeat(row, col);
-                            if (!seat) continue;
-
-                            // Wait until the deleted seat is reached in order
-                            if (!foundDeleted) {
-                                if (seat == deletedSeat) {
-                                    foundDeleted = true;
-                                    if (seat->student)
-                                        lastPlacedRoll = seat->student->rollNumber;
-                                }
-                                continue;
-                            }
+        // outcome[i] indexes 'tally'
+        int* outcome = new int[count];
+        auto runOp = [&](int i, LaneContext* lane) {
+            const LaneOp& op = ops[i];
+            if (op.kind == LaneOp::Insert) {
+                PlaceResult result = placeStudent(op.rollNo, op.batchID, subjectIds[i]);
+                outcome[i] = result == PlacedInVacancy || result == PlacedByShift ? 0 : 2;
+            }
+            else {
+                outcome[i] = removeStudent(op.rollNo, laneOf[i], lane) ? 1 : 2;
+            }
+        };
+
+        if (adjacencyRule) {
+            // Neighbouring columns couple the lanes; replay in the given order
+            // with each delete's collapses run straight after it
+            for (int i = 0; i < count; i++) {
+                if (laneOf[i] < 0) continue;
+                runOp(i, nullptr);
+                tally[outcome[i]]++;
+            }
+        }
+        else {
+            // A segment of the batch runs on both lanes at once. Each op
+            // leaves a trail of (room, lane count) for the rooms it changed;
+            // sweeping the trails in batch order gives every room's occupancy
+            // as serial execution would see it after each op.
+            UndoLog::Mark* marks = new UndoLog::Mark[count];
+            int* trailFrom = new int[count];
+            int* trailTo = new int[count];
+            int* level = new int[2 * roomCount];
+            RoomTrail trails[2];
+            LaneContext lanes[2] = { LaneContext(0, 0, roomCount), LaneContext(1, 0, roomCount) };
+
+            int start = 0;
+            int length = 64;
+            while (start < count) {
+                int end = count - start < length ? count : start + length;
+                for (int r = 0; r < roomCount; r++) {
+                    level[2 * r] = rooms[r]->laneOccupied[0];
+                    level[2 * r + 1] = rooms[r]->laneOccupied[1];
+                }
+                trails[0].size = trails[1].size = 0;
+
+                auto runLane = [&](int parity) {
+                    RoomTrail& trail = trails[parity];
+                    for (int i = start; i < end; i++) {
+                        if (laneOf[i] != parity) continue;
+                        marks[i] = undo[parity].mark();
+                        runOp(i, &lanes[parity]);
+                        trailFrom[i] = trail.size;
+                        for (int e = marks[i].entries; e < undo[parity].size(); e++) {
+                            int room = undo[parity].seatAt(e)->roomIndex;
+                            trail.add(room, rooms[room]->laneOccupied[parity]);
+                        }
+                        trailTo[i] = trail.size;
+                    }
+                };
+                sharedPool().parallelFor(2, runLane);
+
+                int cut = -1;
+                for (int i = start; i < end && cut < 0; i++) {
+                    int parity = laneOf[i];
+                    if (parity < 0) continue;
+                    RoomTrail& trail = trails[parity];
+                    for (int t = trailFrom[i]; t < trailTo[i]; t++) {
+                        level[2 * trail.rooms[t] + parity] = trail.counts[t];
+                    }
+                    tally[outcome[i]]++;
+                    if (ops[i].kind != LaneOp::Delete) continue;
+                    for (int t = trailFrom[i]; t < trailTo[i] && cut < 0; t++) {
+                        int room = trail.rooms[t];
+                        if (level[2 * room] + level[2 * room + 1] < rooms[room]->getMinOccupancy()) cut = i;
+                    }
+                }
+                if (cut < 0) {
+                    start = end;
+                    length *= 2;
+                    continue;
+                }
 
-                            if (!seat->student) continue; // empty donor, skip
+                // Undo each lane from its first op past the cut, then run
+                // the delete's collapses on the building as it stood
+                for (int parity = 0; parity < 2; parity++) {
+                    for (int i = cut + 1; i < end; i++) {
+                        if (laneOf[i] != parity) continue;
+                        rollbackTo(parity, marks[i]);
+                        break;
+                    }
+                }
+                int parity = laneOf[cut];
+                LaneContext local(parity, 0, roomCount);
+                for (int t = trailFrom[cut]; t < trailTo[cut]; t++) local.flag(trails[parity].rooms[t]);
+                runDeferredCollapses(&local, 1);
 
-                            Student* donor = seat->student;
-                            if (!donor) continue;
+                length = cut + 1 - start < 8 ? 16 : 2 * (cut + 1 - start);
+                start = cut + 1;
+            }
 
-                            // Get destination room (vacancy's room)
-                            Block* destBlock = nullptr;
-                            Floor* destFloor = nullptr;
-                            Room* destRoom = getRoomFromSeat(vacancy, &destBlock, &destFloor);
-                            if (!destRoom) continue;
+            delete[] marks;
+            delete[] trailFrom;
+            delete[] trailTo;
+            delete[] level;
+        }
 
-                            // 1️⃣ Parity check (odd/even batch-column rule)
-                            if (!matchesParity(donor->batchID, vacancy->col))
-                                continue;
+        if (totals) {
+            totals[0] += tally[0];
+            totals[1] += tally[1];
+            totals[2] += tally[2];
+        }
+        else {
+            std::cout << "Lane placement: " << tally[0] << " placed, " << tally[1] << " deleted, "
+                << tally[2] << " failed.\n";
+        }
 
-                            // 2️⃣ Subject restriction rule
-                            if (!checkSubjectRestriction(destRoom, donor->batchID, donor->subject.c_str()))
-                                continue;
+        delete[] laneOf;
+        delete[] subjectIds;
+        delete[] outcome;
+    }
 
-                            // 3️⃣ Ascending roll order check
-                            if (lastPlacedRoll != -1 && donor->rollNumber < lastPlacedRoll)
-                                continue;
+    // Apply a batch of inserts and deletes with every block on its own
+    // worker, leaving the building as insertStudent and deleteStudent would
+    // one op at a time. Ops enter the first block in batch order and pass
+    // from each block's worker to the next one's, so every block sees them
+    // in order. An insert seeks its seat block by block; a student it
+    // displaces goes on to the later blocks with it, and the earlier blocks
+    // that could still take that student stay held, their workers waiting,
+    // until the shift ends. A delete is found the same way, then its
+    // backward walk and vacancy are handed on block by block; it holds the
+    // block before its own, which a collapse may pour into, and the blocks
+    // it has walked until the last block has run its collapses.
+    void applyInBlocks(const LaneOp* ops, int count) {
+        WriteGuard guard(this);
+        if (roomCount == 0) return;
+        isolateRooms();
+
+        const int last = totalBlocks - 1;
+        int* blockOfRoom = new int[roomCount];
+        for (int i = 0, k = 0; i < roomCount; i++) {
+            while (rooms[i]->floor->block != blocks[k]) k++;
+            blockOfRoom[i] = k;
+        }
+        BlockOwner** owners = new BlockOwner*[totalBlocks];
+        for (int k = 0, first = 0; k < totalBlocks; k++) {
+            int end = first;
+            while (end < roomCount && blockOfRoom[end] == k) end++;
+            owners[k] = new BlockOwner(first, end, count);
+            first = end;
+        }
 
-                            // ✅ All rules satisfied → perform backward shift
-                            seat->student = nullptr;
-                            vacancy->student = donor;
-                            lastPlacedRoll = donor->rollNumber;
+        // Records for the inserts come from the pools up front; the workers
+        // only seat them
+        BlockWave* waves = new BlockWave[count];
+        Student** records = new Student*[count];
+        int pending = 0;
+        for (int i = 0; i < count; i++) {
+            const LaneOp& op = ops[i];
+            BlockWave& wave = waves[i];
+            wave.student = nullptr;
+            wave.shifting = false;
+            wave.walk.deletedSeat = nullptr;
+            wave.removed = nullptr;
+            wave.firstHeld = -1;
+            wave.lastHeld = -1;
+            wave.outcome = 2;
+            records[i] = nullptr;
+            if (op.kind == LaneOp::Insert) {
+                if (op.batchID < 22 || op.batchID > 25) continue;
+                int subjectId = subjects.intern(op.subject);
+                records[i] = pools[op.batchID & 1].allocate(op.rollNo, op.batchID,
+                    subjects.name(subjectId), subjectId);
+                wave.student = records[i];
+            }
+            owners[0]->inbox[owners[0]->tail++] = i;
+            pending++;
+        }
 
-                            // Update occupancy counts if crossing rooms
-                            if (rm != destRoom) {
-                                if (rm->occupiedSeats > 0) rm->occupiedSeats--;
-                                destRoom->occupiedSeats++;
-                            }
+        // Each block's rooms log into its owner while the workers run
+        for (int k = 0; k < totalBlocks; k++) {
+            BlockOwner& owner = *owners[k];
+            owner.cursors[0] = cursors[0];
+            owner.cursors[1] = cursors[1];
+            for (int i = owner.firstRoom; i < owner.endRoom; i++) {
+                rooms[i]->undo = owner.undo;
+                rooms[i]->cursors = owner.cursors;
+                rooms[i]->journal = nullptr;
+            }
+            blocks[k]->occupancy.parent = nullptr;
+        }
 
-                            // If donor room underfilled → roomCollapse
-                            if (rm->occupiedSeats < rm->getMinOccupancy())
-                                roomCollapse(rm);
+        // What a worker does with an op once its part in the block is done:
+        // pass it on, pass it on and hold the block, let go of the blocks it
+        // held and hold this one instead, or end it
+        enum Step { Pass, Hold, Slide, Finish };
+        const LaneKernels& kernels = laneKernels();
+        TextStream collapses;       // written by the last block's worker only
+
+        auto seatIn = [&](int k, Student* student, Room** room) {
+            return findPositionIn(owners[k]->firstRoom, owners[k]->endRoom, student->rollNumber,
+                student->batchID, student->subjectId, room);
+        };
+        // Whether any student of the lane rolled at or above 'rollNo' could
+        // still be seated in the block
+        auto openTo = [&](int k, int parity, int rollNo) {
+            for (int r = owners[k]->firstRoom; r < owners[k]->endRoom; r++) {
+                const int* rolls = rooms[r]->laneRolls(parity);
+                if (kernels.findFirstAbove(rolls, rooms[r]->laneLength(parity), rollNo, true) >= 0) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        auto restore = [this](Seat* seat, Student* previous) {
+            rooms[seat->roomIndex]->setStudent(seat, previous);
+        };
+        auto undoOp = [&](int k) {
+            for (int p = 0; p < 2; p++) {
+                owners[k]->undo[p].rollbackTo(owners[k]->start[p], students, pools[p], restore);
+            }
+        };
+
+        // An insert in block k. The search goes through the held blocks
+        // first, as a displaced student's search starts from the first room.
+        auto insertStep = [&](int i, int k) {
+            BlockWave& wave = waves[i];
+            Student* student = wave.student;
+            Room* room = nullptr;
+            Seat* seat = nullptr;
+            while (true) {
+                for (int b = wave.firstHeld; wave.shifting && b >= 0 && !seat; b = owners[b]->nextHeld) {
+                    seat = seatIn(b, student, &room);
+                }
+                if (!seat) seat = seatIn(k, student, &room);
+                if (!seat) break;
+
+                Student* displaced = seat->student;
+                room->setStudent(seat, student);
+                if (!displaced) {
+                    wave.outcome = 0;
+                    return Finish;
+                }
+                wave.shifting = true;
+                student = displaced;
+                seat = nullptr;
+            }
+            wave.student = student;
+            if (k < last) {
+                return wave.shifting || openTo(k, student->batchID & 1, student->rollNumber) ? Hold : Pass;
+            }
 
-                            // Vacancy moves to donor’s seat → next loop continues
-                            vacancy = seat;
-                        }
+            // The shift ran out of seats; undo it everywhere it went
+            for (int b = wave.firstHeld; b >= 0; b = owners[b]->nextHeld) undoOp(b);
+            undoOp(k);
+            return Finish;
+        };
+
+        // A delete in block k: find the student, then carry the backward
+        // walk through the block. The last block runs the room collapses
+        // deleteStudent would run.
+        auto deleteStep = [&](int i, int k) {
+            BlockWave& wave = waves[i];
+            BlockOwner& owner = *owners[k];
+            if (!wave.walk.deletedSeat) {
+                Room* room = nullptr;
+                Seat* seat = findRollSeat(ops[i].rollNo, -1, &room, owner.firstRoom, owner.endRoom);
+                if (!seat) return k < last ? Slide : Finish;
+                wave.removed = seat->student;
+                room->setStudent(seat, nullptr);
+                wave.walk.deletedSeat = seat;
+                wave.walk.vacancy = seat;
+                wave.walk.foundDeleted = false;
+                wave.walk.lastPlacedRoll = -1;
+                continueBackward(wave.walk, seat->roomIndex, owner.endRoom, &owner.context);
+                flagForCollapse(room, &owner.context);
+            }
+            else {
+                continueBackward(wave.walk, owner.firstRoom, owner.endRoom, &owner.context);
+            }
+            if (k < last) return Hold;
+
+            for (int r = wave.walk.deletedSeat->roomIndex; r < roomCount; r++) {
+                LaneContext& context = owners[blockOfRoom[r]]->context;
+                if (!context.isFlagged(r)) continue;
+                context.unflag(r);
+                if (rooms[r]->occupiedSeats() < rooms[r]->getMinOccupancy()) {
+                    collapseRoomIn(0, rooms[r], collapses);
+                }
+            }
+            wave.outcome = 1;
+            return Finish;
+        };
+
+        std::mutex lock;
+        auto work = [&](int k) {
+            BlockOwner& owner = *owners[k];
+            std::unique_lock<std::mutex> held(lock);
+            while (true) {
+                while (owner.head == owner.tail && pending > 0) owner.wake.wait(held);
+                if (owner.head == owner.tail) return;
+                int i = owner.inbox[owner.head++];
+                held.unlock();
+
+                owner.start[0] = owner.undo[0].mark();
+                owner.start[1] = owner.undo[1].mark();
+                Step step = ops[i].kind == LaneOp::Insert ? insertStep(i, k) : deleteStep(i, k);
+
+                held.lock();
+                BlockWave& wave = waves[i];
+                if (step == Slide || step == Finish) {
+                    for (int b = wave.firstHeld; b >= 0; b = owners[b]->nextHeld) {
+                        owners[b]->holder = -1;
+                        owners[b]->wake.notify_one();
                     }
-                    rm = rm->next;
+                    wave.firstHeld = -1;
+                    wave.lastHeld = -1;
+                }
+                if (step == Finish) {
+                    if (--pending == 0) {
+                        for (int b = 0; b < totalBlocks; b++) owners[b]->wake.notify_one();
+                    }
+                    continue;
+                }
+                if (step != Pass) {
+                    owner.holder = i;
+                    owner.nextHeld = -1;
+                    if (wave.lastHeld >= 0) owners[wave.lastHeld]->nextHeld = k;
+                    else wave.firstHeld = k;
+                    wave.lastHeld = k;
+                }
+                BlockOwner& next = *owners[k + 1];
+                next.inbox[next.tail++] = i;
+                next.wake.notify_one();
+                while (owner.holder == i) owner.wake.wait(held);
+            }
+        };
+        for (int k = 0; k < totalBlocks; k++) owners[k]->worker = std::thread(work, k);
+        for (int k = 0; k < totalBlocks; k++) owners[k]->worker.join();
+
+        // Reattach the rooms and fold the owners' logs back in, in block order
+        const int cap = rooms[0]->capacity();
+        occupancy.clear();
+        for (int k = 0; k < totalBlocks; k++) {
+            BlockOwner& owner = *owners[k];
+            for (int i = owner.firstRoom; i < owner.endRoom; i++) {
+                rooms[i]->undo = undo;
+                rooms[i]->cursors = cursors;
+                rooms[i]->journal = journal;
+            }
+            blocks[k]->occupancy.parent = &occupancy;
+            for (int batch = kFirstBatch; batch < kFirstBatch + kBatchCount; batch++) {
+                occupancy.add(batch, blocks[k]->occupancy.ofBatch(batch));
+            }
+            for (int p = 0; p < 2; p++) {
+                int from = undo[p].size();
+                undo[p].takeFrom(owner.undo[p]);
+                for (int j = from; journal && j < undo[p].size(); j++) {
+                    Seat* seat = undo[p].seatAt(j);
+                    journal->recordSeat(seat->roomIndex * cap + seat->lane, seat->student);
+                }
+                if (owner.cursors[p].tail > cursors[p].tail) cursors[p].tail = owner.cursors[p].tail;
+                if (owner.cursors[p].maxRoll > cursors[p].maxRoll) {
+                    cursors[p].maxRoll = owner.cursors[p].maxRoll;
                 }
-                floor = floor->next;
             }
-            block = block->next;
         }
 
-        // When loop ends, no more valid donors exist.
-        return;
-    }
-
-//   Backward collapse
-    //void backwardCollapse(Seat* deletedSeat, Room* room) {
-    //    // Simplified backward collapse - shifts next students backward
-    //    Seat* current = deletedSeat;
-
-    //    // Find next occupied seat in sequence
-    //    Block* block = firstBlock;
-    //    bool foundDeleted = false;
-
-    //    while (block) {
-    //        Floor* floor = block->firstFloor;
-    //        while (floor) {
-    //            Room* rm = floor->firstRoom;
-    //            while (rm) {
-    //                for (int col = 0; col < gridSize; col++) {
-    //                    for (int row = 0; row < gridSize; row++) {
-    //                        Seat* seat = rm->getSeat(row, col);
-
-    //                        if (!foundDeleted) {
-    //                            if (seat == deletedSeat) foundDeleted = true;
-    //                            continue;
-    //                        }
-
-    //                        if (seat && seat->student) {
-    //                            current->student = seat->student;
-    //                            seat->student = nullptr;
-    //                            rm->occupiedSeats--;
-    //                            if (room && current != deletedSeat) room->occupiedSeats++;
-    //                            current = seat;
-    //                            return;
-    //                        }
-    //                    }
-    //                }
-    //                rm = rm->next;
-    //            }
-    //            floor = floor->next;
-    //        }
-    //        block = block->next;
-    //    }
-    //}
-
-    // Room collapse (stub - borrow from previous room)
+        // The indexes follow the ops in batch order
+        int tally[3] = { 0, 0, 0 };     // placed, deleted, failed
+        for (int i = 0; i < count; i++) {
+            tally[waves[i].outcome]++;
+            if (waves[i].outcome == 0) admit(records[i]);
+            else if (waves[i].outcome == 1) retire(waves[i].removed);
+            else if (records[i]) pools[records[i]->batchID & 1].release(records[i]);
+        }
+        collapses.writeTo(std::cout);
+        std::cout << "Block placement: " << tally[0] << " placed, " << tally[1] << " deleted, "
+            << tally[2] << " failed.\n";
+
+        for (int k = 0; k < totalBlocks; k++) delete owners[k];
+        delete[] owners;
+        delete[] waves;
+        delete[] records;
+        delete[] blockOfRoom;
+    }
+
+    // Debug check for applyInLanes: runs the batch through it on one clone
+    // and through insertStudent and deleteStudent on another, then lists the
+    // seats where the two differ. Returns the number of differing seats.
+    int checkLaneReplay(const LaneOp* ops, int count) {
+        return replayDifferences(ops, count, "applyInLanes", [&](BasicSeatingSystem* system) {
+            system->applyInLanes(ops, count);
+        });
+    }
+
+    // The same check for applyInBlocks
+    int checkBlockReplay(const LaneOp* ops, int count) {
+        return replayDifferences(ops, count, "applyInBlocks", [&](BasicSeatingSystem* system) {
+            system->applyInBlocks(ops, count);
+        });
+    }
+
+    // Room collapse - move the room's students into the previous room's free
+    // parity seats; if that leaves the floor under half full, collapse the floor
     void roomCollapse(Room* room) {
-        std::cout << "Room collapse triggered (stub implementation).\n";
+        WriteGuard guard(this);
+        collapseRoomIn(0, room, std::cout);
     }
 
-    // Floor collapse
+    // Floor collapse - pour every room of the floor into its predecessor in
+    // order; if that leaves the block under half full, collapse the block
     void floorCollapse(Floor* floor) {
-        std::cout << "Floor collapse triggered (stub implementation).\n";
+        WriteGuard guard(this);
+        collapseFloorIn(0, floor, std::cout);
     }
 
-    // Block collapse
+    // Block collapse - pour every room of the block into its predecessor
     void blockCollapse(Block* block) {
-        std::cout << "Block collapse triggered (stub implementation).\n";
+        WriteGuard guard(this);
+        collapseBlockIn(0, block, std::cout);
+    }
+
+    // The three collapses by location, as printRoom finds a room
+    void roomCollapse(const char* blockID, int floorNo, int roomNo) {
+        WriteGuard guard(this);
+        Room* room = findRoom(findFloor(findBlock(blockID), floorNo), roomNo);
+        if (!room) {
+            std::cout << "Room not found.\n";
+            return;
+        }
+        collapseRoomIn(0, room, std::cout);
+    }
+
+    void floorCollapse(const char* blockID, int floorNo) {
+        WriteGuard guard(this);
+        Floor* floor = findFloor(findBlock(blockID), floorNo);
+        if (!floor) {
+            std::cout << "Floor not found.\n";
+            return;
+        }
+        collapseFloorIn(0, floor, std::cout);
+    }
+
+    void blockCollapse(const char* blockID) {
+        WriteGuard guard(this);
+        Block* block = findBlock(blockID);
+        if (!block) {
+            std::cout << "Block not found.\n";
+            return;
+        }
+        collapseBlockIn(0, block, std::cout);
     }
 
     // Print room
     void printRoom(char blockID, int floorNo, int roomNo) {
+        const char id[2] = { blockID, '\0' };
+        printRoom(id, floorNo, roomNo);
+    }
+
+    void printRoom(const char* blockID, int floorNo, int roomNo) {
+        ReadGuard guard(this);
         Block* block = findBlock(blockID);
         if (!block) {
             std::cout << "Block not found.\n";
@@ -939,8 +4972,8 @@ public:
         std::cout << "\n=== Block " << blockID << " - Floor " << floorNo
             << " - Room " << roomNo << " ===\n";
 
-        for (int r = 0; r < gridSize; r++) {
-            for (int c = 0; c < gridSize; c++) {
+        for (int r = 0; r < side(); r++) {
+            for (int c = 0; c < side(); c++) {
                 Seat* seat = room->getSeat(r, c);
                 if (seat && seat->student) {
                     std::cout << "[" << seat->student->rollNumber << "] ";
@@ -956,62 +4989,90 @@ public:
 
     // Export seating plan
     void exportSeatingPlan(const char* fileName) {
+        ReadGuard guard(this);
         std::ofstream file(fileName);
         if (!file) {
             std::cout << "Cannot create file.\n";
             return;
         }
 
-        Block* block = firstBlock;
-        while (block) {
-            Floor* floor = block->firstFloor;
-            while (floor) {
-                Room* room = floor->firstRoom;
-                while (room) {
-                    file << "Block " << block->blockID << " - Floor "
-                        << floor->floorNumber << " - Room " << room->roomNumber << "\n";
+        writeBlocksInOrder(file, [this](int i, std::ostream& out) {
+            writeBlockPlan(blocks[i], out);
+        });
 
-                    for (int r = 0; r < gridSize; r++) {
-                        for (int c = 0; c < gridSize; c++) {
-                            Seat* seat = room->getSeat(r, c);
-                            if (seat && seat->student) {
-                                file << "[" << seat->student->rollNumber << "] ";
-                            }
-                            else {
-                                file << "[Empty] ";
-                            }
-                        }
-                        file << "\n";
-                    }
-                    file << "\n";
-                    room = room->next;
-                }
-                floor = floor->next;
-            }
-            block = block->next;
+        file.close();
+        std::cout << "Seating plan exported to " << fileName << "\n";
+    }
+
+    // Export the plan in a fixed-width layout that republishPlan can patch
+    // room by room
+    void exportFixedPlan(const char* fileName) {
+        WriteGuard guard(this);
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cout << "Cannot create file.\n";
+            return;
         }
 
+        delete[] planOffsets;
+        planOffsets = new std::streamoff[roomCount];
+        for (int i = 0; i < roomCount; i++) {
+            planOffsets[i] = file.tellp();
+            writeFixedRoom(rooms[i], file);
+        }
+        publishedPlan = fileName;
+
         file.close();
         std::cout << "Seating plan exported to " << fileName << "\n";
     }
 
-    // Find student by roll
+    // Rewrite, in place, only the rooms of the last fixed-layout plan whose
+    // seats changed since it was written. Returns the number of rooms rewritten.
+    int republishPlan() {
+        WriteGuard guard(this);
+        if (!planOffsets) {
+            std::cout << "No fixed-layout plan to republish.\n";
+            return 0;
+        }
+
+        std::fstream file(publishedPlan.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        if (!file) {
+            std::cout << "Cannot open file.\n";
+            return 0;
+        }
+
+        int rewritten = 0;
+        for (int i = 0; i < roomCount; i++) {
+            if (!rooms[i]->dirty[0] && !rooms[i]->dirty[1]) continue;
+            file.seekp(planOffsets[i]);
+            writeFixedRoom(rooms[i], file);
+            rewritten++;
+        }
+
+        file.close();
+        std::cout << "Seating plan republished: " << rewritten << " of "
+            << roomCount << " rooms rewritten.\n";
+        return rewritten;
+    }
+
+    // Find student by roll (the returned record stays valid until the next mutation)
     Student* findStudentByRoll(int rollNo) {
+        ReadGuard guard(this);
         Block* block = firstBlock;
         while (block) {
             Floor* floor = block->firstFloor;
             while (floor) {
                 Room* room = floor->firstRoom;
                 while (room) {
-                    for (int r = 0; r < gridSize; r++) {
-                        for (int c = 0; c < gridSize; c++) {
+                    for (int r = 0; r < side() && room->occupiedSeats() > 0; r++) {
+                        for (int c = 0; c < side(); c++) {
                             Seat* seat = room->getSeat(r, c);
                             if (seat && seat->student && seat->student->rollNumber == rollNo) {
                                 std::cout << "\n=== Student Found ===\n";
                                 std::cout << "Roll Number: " << seat->student->rollNumber << "\n";
                                 std::cout << "Batch: " << seat->student->batchID << "\n";
-                                std::cout << "Subject: " << seat->student->subject.c_str() << "\n";
-                                std::cout << "Location: Block " << block->blockID
+                                std::cout << "Subject: " << seat->student->subject << "\n";
+                                std::cout << "Location: Block " << block->blockID.c_str()
                                     << ", Floor " << floor->floorNumber
                                     << ", Room " << room->roomNumber
                                     << ", Row " << r << ", Col " << c << "\n";
@@ -1029,8 +5090,14 @@ public:
         return nullptr;
     }
 
-    // Find student by location
+    // Find student by location (same lifetime as findStudentByRoll)
     Student* findStudentByLocation(char blockID, int floorNo, int roomNo, int row, int col) {
+        const char id[2] = { blockID, '\0' };
+        return findStudentByLocation(id, floorNo, roomNo, row, col);
+    }
+
+    Student* findStudentByLocation(const char* blockID, int floorNo, int roomNo, int row, int col) {
+        ReadGuard guard(this);
         Block* block = findBlock(blockID);
         if (!block) {
             std::cout << "Block not found.\n";
@@ -1061,7 +5128,7 @@ public:
                 << ", Room " << roomNo << ", Row " << row << ", Col " << col << "\n";
             std::cout << "Roll Number: " << seat->student->rollNumber << "\n";
             std::cout << "Batch: " << seat->student->batchID << "\n";
-            std::cout << "Subject: " << seat->student->subject.c_str() << "\n";
+            std::cout << "Subject: " << seat->student->subject << "\n";
             return seat->student;
         }
         else {
@@ -1070,155 +5137,486 @@ public:
         }
     }
 
+    // Nearest vacant seat a student of 'batchID' taking 'subject' may take
+    // (column parity, subject restriction and, when on, the adjacency rule),
+    // in steps over the seat links from the given seat: front/back/left/right
+    // in a room and on to the next floor, up/down between floors and across
+    // to neighbouring blocks.
+    // Visits at most 'maxSeats' seats; 'found' receives the seat's location.
+    bool findNearestVacancy(char blockID, int floorNo, int roomNo, int row, int col,
+        int batchID, const char* subject, StudentRecord* found = nullptr, int maxSeats = 4096) {
+        const char id[2] = { blockID, '\0' };
+        return findNearestVacancy(id, floorNo, roomNo, row, col, batchID, subject, found, maxSeats);
+    }
+
+    bool findNearestVacancy(const char* blockID, int floorNo, int roomNo, int row, int col,
+        int batchID, const char* subject, StudentRecord* found = nullptr, int maxSeats = 4096) {
+        ReadGuard guard(this);
+        if (batchID < 22 || batchID > 25) {
+            std::cout << "Invalid batch ID! Must be 22-25.\n";
+            return false;
+        }
+        Room* startRoom = findRoom(findFloor(findBlock(blockID), floorNo), roomNo);
+        Seat* start = startRoom ? startRoom->getSeat(row, col) : nullptr;
+        if (!start) {
+            std::cout << "Invalid seat coordinates.\n";
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(searchLock);
+        const int cap = rooms[0]->capacity();
+        int subjectId = subjects.find(subject);
+        search.begin(roomCount * cap, roomCount, maxSeats > 0 ? maxSeats : 1);
+        search.push(start, startRoom->index * cap + start->lane, 0);
+
+        for (int head = 0; head < search.size(); head++) {
+            Seat* seat = search.at(head);
+            Room* room = rooms[seat->roomIndex];
+            if (!seat->student && matchesParity(batchID, seat->col) &&
+                adjacencyAllows(seat, subjectId)) {
+                int open = search.roomVerdict(room->index);
+                if (open < 0) {
+                    open = checkSubjectRestriction(room, batchID, subjectId);
+                    search.setRoomVerdict(room->index, open);
+                }
+                if (open) {
+                    std::cout << "Nearest vacancy: Block "
+                        << room->floor->block->blockID.c_str() << ", Floor "
+                        << room->floor->floorNumber << ", Room " << room->roomNumber
+                        << ", Row " << seat->row << ", Col " << seat->col << " ("
+                        << search.stepsAt(head) << " steps)\n";
+                    if (found) {
+                        StudentRecord record = { kVacantRoll, batchID, subjectId,
+                            room->floor->block->blockID.c_str(), room->floor->floorNumber,
+                            room->roomNumber, seat->row, seat->col };
+                        *found = record;
+                    }
+                    return true;
+                }
+            }
+
+            Seat* links[8] = { seat->front, seat->back, seat->left, seat->right,
+                seat->up, seat->down, seat->leftBuilding, seat->rightBuilding };
+            for (int d = 0; d < 8; d++) {
+                if (!links[d]) continue;
+                // A clone's shared rooms link into its source; step into this plan's view
+                Room* next = rooms[links[d]->roomIndex];
+                Seat* target = next->getSeat(links[d]->row, links[d]->col);
+                search.push(target, next->index * cap + target->lane, search.stepsAt(head) + 1);
+            }
+        }
+        std::cout << "No eligible vacancy within " << search.size() << " seats.\n";
+        return false;
+    }
+
     // Load from file
+    // Load a roster ("batch roll subject" per line) through three stages: a
+    // reader thread streams the file in chunks, a parser thread turns them
+    // into records, and this thread seats the records in batches with
+    // applyInLanes. Bounded rings between the stages hold the reader and
+    // parser back whenever placement falls behind.
     void loadFromFile(const char* fileName) {
-        std::ifstream file(fileName);
+        WriteGuard guard(this);
+        std::ifstream file(fileName, std::ios::binary);
         if (!file) {
             std::cout << "Cannot open file.\n";
             return;
         }
 
-        int roll, batch;
-        char subject[100];
-        int count = 0;
-
-        while (file >> batch >> roll >> subject) {
-            insertStudent(roll, batch, subject);
-            count++;
+        const int chunkSize = 64 * 1024;
+        const int batchSize = 512;
+        SpscRing<RosterChunk> chunks(4);
+        SpscRing<RosterRecord> records(4 * batchSize);
+        int chunksRead = 0;
+        int parsed = 0;
+        int parserWaits = 0;
+        bool malformed = false;
+
+        std::thread reader([&]() {
+            while (true) {
+                RosterChunk chunk;
+                chunk.data = new char[chunkSize];
+                file.read(chunk.data, chunkSize);
+                chunk.size = static_cast<int>(file.gcount());
+                if (chunk.size <= 0) {
+                    delete[] chunk.data;
+                    break;
+                }
+                chunksRead++;
+                chunks.push(chunk);
+            }
+            chunks.close();
+        });
+
+        // After a malformed field the parser still drains the reader
+        std::thread parser([&]() {
+            RosterParser parse;
+            auto emit = [&](const RosterRecord& record) {
+                if (records.push(record)) parserWaits++;
+                parsed++;
+            };
+            RosterChunk chunk;
+            while (chunks.pop(chunk, nullptr)) {
+                parse.feed(chunk.data, chunk.size, emit);
+                delete[] chunk.data;
+            }
+            parse.finish(emit);
+            malformed = parse.malformed();
+            records.close();
+        });
+
+        // Parser subject id -> id in this system
+        int* subjectMap = nullptr;
+        int mapCapacity = 0;
+        LaneOp* batch = new LaneOp[batchSize];
+        int totals[3] = { 0, 0, 0 };
+        int batches = 0;
+        int placementWaits = 0;
+        RosterRecord record;
+        while (records.pop(record, &placementWaits)) {
+            int n = 0;
+            do {
+                if (record.newSubject) {
+                    if (record.subjectId >= mapCapacity) {
+                        int grownCapacity = mapCapacity ? mapCapacity * 2 : 8;
+                        int* grown = new int[grownCapacity];
+                        for (int i = 0; i < mapCapacity; i++) grown[i] = subjectMap[i];
+                        delete[] subjectMap;
+                        subjectMap = grown;
+                        mapCapacity = grownCapacity;
+                    }
+                    subjectMap[record.subjectId] = subjects.intern(record.newSubject);
+                    delete[] record.newSubject;
+                }
+                batch[n++] = LaneOp::insert(record.rollNo, record.batchID,
+                    subjects.name(subjectMap[record.subjectId]));
+            } while (n < batchSize && records.tryPop(record));
+            applyInLanes(batch, n, totals);
+            batches++;
         }
-
+        reader.join();
+        parser.join();
         file.close();
-        std::cout << "Loaded " << count << " students from file.\n";
+        delete[] batch;
+        delete[] subjectMap;
+
+        if (malformed) {
+            std::cout << "Error: Malformed record after " << parsed
+                << " students; the rest of the file was skipped!\n";
+        }
+        std::cout << "Loaded " << totals[0] << " of " << parsed << " students from file ("
+            << totals[2] << " could not be seated).\n";
+        std::cout << "Ingestion: " << chunksRead << " chunks read, " << batches
+            << " placement batches; the parser waited " << parserWaits
+            << " times for placement, placement " << placementWaits << " times for the parser.\n";
     }
 
     // Save to file
     void saveToFile(const char* fileName) {
+        ReadGuard guard(this);
         std::ofstream file(fileName);
         if (!file) {
             std::cout << "Cannot create file.\n";
             return;
         }
 
-        Block* block = firstBlock;
-        while (block) {
-            Floor* floor = block->firstFloor;
-            while (floor) {
-                Room* room = floor->firstRoom;
-                while (room) {
-                    for (int r = 0; r < gridSize; r++) {
-                        for (int c = 0; c < gridSize; c++) {
-                            Seat* seat = room->getSeat(r, c);
-                            if (seat && seat->student) {
-                                file << seat->student->rollNumber << " "
-                                    << seat->student->batchID << " "
-                                    << seat->student->subject.c_str() << "\n";
-                            }
-                        }
-                    }
-                    room = room->next;
+        writeBlocksInOrder(file, [this](int i, std::ostream& out) {
+            writeBlockRoster(blocks[i], out);
+        });
+
+        file.close();
+        std::cout << "Seating plan saved to " << fileName << "\n";
+    }
+
+    // Start journaling: a checkpoint of the current state goes to
+    // 'snapshotFile' and every later seat change is appended to 'journalFile'.
+    // A new checkpoint is taken after every 'checkpointInterval' records.
+    bool openJournal(const char* journalFile, const char* snapshotFile, int checkpointInterval = 4096) {
+        WriteGuard guard(this);
+        journalPath = journalFile;
+        snapshotPath = snapshotFile;
+        checkpointEvery = checkpointInterval;
+        if (!writeCheckpoint()) {
+            std::cout << "Cannot open journal.\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Take a checkpoint now, restarting the journal
+    void checkpoint() {
+        WriteGuard guard(this);
+        if (!journal) {
+            std::cout << "Journaling is off.\n";
+            return;
+        }
+        if (!writeCheckpoint()) {
+            std::cout << "Error: Checkpoint failed; journaling stopped.\n";
+        }
+    }
+
+    // Stop journaling; the files stay as they are
+    void closeJournal() {
+        WriteGuard guard(this);
+        detachJournal();
+    }
+
+    // Copy the current session's occupancy into 'overlay'
+    void captureSession(SessionOverlay& overlay) {
+        ReadGuard guard(this);
+        const int cap = rooms[0]->capacity();
+        overlay.prepare(roomCount * cap, occupancy.total() + unindexedStudents());
+        for (int i = 0; i < roomCount; i++) {
+            for (int pos = 0; pos < cap; pos++) {
+                Student* student = rooms[i]->seatAtLane(pos)->student;
+                if (student) {
+                    overlay.place(i * cap + pos, student->rollNumber, student->batchID,
+                        student->subjectId);
                 }
-                floor = floor->next;
             }
-            block = block->next;
         }
+    }
 
-        file.close();
-        std::cout << "Seating plan saved to " << fileName << "\n";
+    // Make 'overlay' the current session: the building is cleared as by
+    // reset() and every student of the overlay is seated where it says
+    bool activateSession(const SessionOverlay& overlay) {
+        WriteGuard guard(this);
+        const int cap = rooms[0]->capacity();
+        if (overlay.seatTotal() != roomCount * cap) {
+            std::cout << "Error: Session was captured on a different building!\n";
+            return false;
+        }
+        if (inTransaction) {
+            std::cout << "Error: Cannot switch sessions inside a transaction!\n";
+            return false;
+        }
+
+        SeatJournal* active = journal;
+        attachJournal(nullptr);
+        clearSession();
+        for (int seatId = 0; seatId < overlay.seatTotal(); seatId++) {
+            int entry = overlay.studentAt(seatId);
+            if (entry < 0) continue;
+            int subjectId = overlay.subjectOf(entry);
+            Student* student = pools[overlay.batchOf(entry) & 1].allocate(overlay.rollOf(entry),
+                overlay.batchOf(entry), subjects.name(subjectId), subjectId);
+            Room* room = rooms[seatId / cap];
+            room->setStudent(room->seatAtLane(seatId % cap), student);
+            admit(student);
+        }
+        undo[0].discard();
+        undo[1].discard();
+        attachJournal(active);
+        if (journal && !writeCheckpoint()) {
+            std::cout << "Error: Checkpoint failed; journaling stopped.\n";
+        }
+        return true;
+    }
+
+    // Seats holding different students here and in 'other' (a clone, or a
+    // plan of the same shape). Rooms the two still share are skipped
+    // unread. Returns the number of differing seats; 'print' lists them.
+    int planDifferences(BasicSeatingSystem& other, bool print) {
+        if (&other == this) return 0;
+        ReadGuard guard(this);
+        ReadGuard otherGuard(&other);
+        const int cap = rooms[0]->capacity();
+        if (other.roomCount != roomCount || other.rooms[0]->capacity() != cap) {
+            std::cout << "Error: Plans are for buildings of different shapes!\n";
+            return 0;
+        }
+
+        int differences = 0;
+        for (int i = 0; i < roomCount; i++) {
+            const int* mine = rooms[i]->lanes;
+            const int* theirs = other.rooms[i]->lanes;
+            if (mine == theirs) continue;
+
+            for (int pos = 0; pos < cap; pos++) {
+                bool same = mine[pos] == theirs[pos] && mine[cap + pos] == theirs[cap + pos];
+                if (same && mine[pos] != kVacantRoll) {
+                    String subject(subjects.name(mine[2 * cap + pos]));
+                    same = subject == other.subjects.name(theirs[2 * cap + pos]);
+                }
+                if (same) continue;
+
+                differences++;
+                if (!print) continue;
+                printSeatId(i * cap + pos);
+                std::cout << ": ";
+                if (mine[pos] == kVacantRoll) std::cout << "-";
+                else std::cout << mine[pos];
+                std::cout << " -> ";
+                if (theirs[pos] == kVacantRoll) std::cout << "-";
+                else std::cout << theirs[pos];
+                std::cout << "\n";
+            }
+        }
+        if (print) std::cout << differences << " seats differ.\n";
+        return differences;
+    }
+
+    // Students seated in both sessions, with their two seats. Returns the
+    // number of conflicts; 'print' lists them.
+    int sessionConflicts(const SessionOverlay& first, const SessionOverlay& second, bool print) {
+        ReadGuard guard(this);
+        const int cap = rooms[0]->capacity();
+        if (first.seatTotal() != roomCount * cap || second.seatTotal() != roomCount * cap) {
+            std::cout << "Error: Session was captured on a different building!\n";
+            return 0;
+        }
+
+        RollMap seatOfRoll(first.size());
+        for (int seatId = 0; seatId < first.seatTotal(); seatId++) {
+            int entry = first.studentAt(seatId);
+            if (entry >= 0) seatOfRoll.put(first.rollOf(entry), seatId);
+        }
+
+        int conflicts = 0;
+        for (int seatId = 0; seatId < second.seatTotal(); seatId++) {
+            int entry = second.studentAt(seatId);
+            if (entry < 0) continue;
+            int otherSeat = seatOfRoll.get(second.rollOf(entry));
+            if (otherSeat < 0) continue;
+
+            conflicts++;
+            if (print) {
+                std::cout << "Roll " << second.rollOf(entry) << ": ";
+                printSeatId(otherSeat);
+                std::cout << " and ";
+                printSeatId(seatId);
+                std::cout << "\n";
+            }
+        }
+        if (print) std::cout << conflicts << " students seated in both sessions.\n";
+        return conflicts;
+    }
+
+    // Rebuild the seating from a snapshot plus the journal written after it,
+    // then keep journaling to the same files
+    bool recoverFromJournal(const char* journalFile, const char* snapshotFile,
+        int checkpointInterval = 4096) {
+        WriteGuard guard(this);
+        detachJournal();
+        clearSession();
+
+        if (replayJournal(snapshotFile) < 0) {
+            std::cout << "Cannot read snapshot.\n";
+            return false;
+        }
+        int replayed = replayJournal(journalFile);
+        if (replayed < 0) replayed = 0;
+
+        std::cout << "Recovered " << occupancy.total() << " students ("
+            << replayed << " journal records replayed).\n";
+        journalPath = journalFile;
+        snapshotPath = snapshotFile;
+        checkpointEvery = checkpointInterval;
+        return writeCheckpoint();
     }
 
     // Navigate seating plan interactively
+    // Walk the building room by room. Moves stop at the building's actual
+    // edges: the first and last block, each block's floors and each floor's
+    // rooms; 'j' jumps straight to a block by its ID.
     void navigateSeatingPlan() {
-        char currentBlock = 'A';
-        int currentFloor = 1;
+        if (!firstBlock || !firstBlock->firstFloor) {
+            std::cout << "No rooms to navigate.\n";
+            return;
+        }
+        Block* block = firstBlock;
+        Floor* floor = block->firstFloor;
         int currentRoom = 1;
 
         std::cout << "\n=== Interactive Navigation ===\n";
-        std::cout << "Use: w(up floor) s(down floor) a(prev room) d(next room) q(quit)\n\n";
+        std::cout << "Use: w(up floor) s(down floor) a(prev room) d(next room) "
+            << "j(jump to block) q(quit)\n\n";
 
         while (true) {
-            printRoom(currentBlock, currentFloor, currentRoom);
+            if (currentRoom > floor->totalRooms) currentRoom = floor->totalRooms;
+            printRoom(block->blockID.c_str(), floor->floorNumber, currentRoom);
 
-            std::cout << "Current: Block " << currentBlock << ", Floor "
-                << currentFloor << ", Room " << currentRoom << "\n";
+            std::cout << "Current: Block " << block->blockID.c_str() << ", Floor "
+                << floor->floorNumber << ", Room " << currentRoom << "\n";
             std::cout << "Command: ";
 
             char cmd;
-            std::cin >> cmd;
+            if (!(std::cin >> cmd)) break;
 
             if (cmd == 'q' || cmd == 'Q') break;
 
             if (cmd == 'w' || cmd == 'W') {
-                if (currentFloor < 3) {
-                    currentFloor++;
+                if (floor->next) {
+                    floor = floor->next;
                 }
-                else if (currentBlock > 'A') {
-                    currentBlock--;
-                    currentFloor = 3;
+                else if (block->prev) {
+                    block = block->prev;
+                    floor = block->lastFloor;
                 }
             }
             else if (cmd == 's' || cmd == 'S') {
-                if (currentFloor > 1) {
-                    currentFloor--;
+                if (floor->prev) {
+                    floor = floor->prev;
                 }
-                else if (currentBlock < 'C') {
-                    currentBlock++;
-                    currentFloor = 1;
+                else if (block->next) {
+                    block = block->next;
+                    floor = block->firstFloor;
                 }
             }
             else if (cmd == 'a' || cmd == 'A') {
                 if (currentRoom > 1) {
                     currentRoom--;
                 }
-                else if (currentFloor > 1) {
-                    currentFloor--;
-                    currentRoom = 10;
+                else if (floor->prev) {
+                    floor = floor->prev;
+                    currentRoom = floor->totalRooms;
                 }
-                else if (currentBlock > 'A') {
-                    currentBlock--;
-                    currentFloor = 3;
-                    currentRoom = 10;
+                else if (block->prev) {
+                    block = block->prev;
+                    floor = block->lastFloor;
+                    currentRoom = floor->totalRooms;
                 }
             }
             else if (cmd == 'd' || cmd == 'D') {
-                if (currentRoom < 10) {
+                if (currentRoom < floor->totalRooms) {
                     currentRoom++;
                 }
-                else if (currentFloor < 3) {
-                    currentFloor++;
+                else if (floor->next) {
+                    floor = floor->next;
+                    currentRoom = 1;
+                }
+                else if (block->next) {
+                    block = block->next;
+                    floor = block->firstFloor;
                     currentRoom = 1;
                 }
-                else if (currentBlock < 'C') {
-                    currentBlock++;
-                    currentFloor = 1;
+            }
+            else if (cmd == 'j' || cmd == 'J') {
+                char id[100];
+                std::cout << "Block ID: ";
+                std::cin.width(sizeof(id));
+                if (!(std::cin >> id)) break;
+                Block* target = findBlock(id);
+                if (target) {
+                    block = target;
+                    floor = block->firstFloor;
                     currentRoom = 1;
                 }
+                else {
+                    std::cout << "Block not found.\n";
+                }
             }
         }
     }
 
     // Display summary
     void displaySummary() {
-        int totalStudents = 0;
-        int totalSeats = 0;
-        int totalRooms = 0;
+        ReadGuard guard(this);
         int totalFloors = 0;
-
-        Block* block = firstBlock;
-        while (block) {
-            Floor* floor = block->firstFloor;
-            while (floor) {
-                totalFloors++;
-                Room* room = floor->firstRoom;
-                while (room) {
-                    totalRooms++;
-                    totalSeats += gridSize * gridSize;
-                    totalStudents += room->occupiedSeats;
-                    room = room->next;
-                }
-                floor = floor->next;
-            }
-            block = block->next;
-        }
+        for (int i = 0; i < totalBlocks; i++) totalFloors += blocks[i]->totalFloors;
+        int totalRooms = roomCount;
+        int totalSeats = roomCount > 0 ? roomCount * rooms[0]->capacity() : 0;
+        int totalStudents = occupancy.total();
 
         std::cout << "\n=== Seating System Summary ===\n";
         std::cout << "Total Blocks: " << totalBlocks << "\n";
@@ -1229,53 +5627,236 @@ public:
         std::cout << "Empty Seats: " << (totalSeats - totalStudents) << "\n";
         std::cout << "Occupancy Rate: "
             << (totalSeats > 0 ? (totalStudents * 100.0 / totalSeats) : 0)
-            << "%\n\n";
+            << "%\n";
+        for (int batch = kFirstBatch; batch < kFirstBatch + kBatchCount; batch++) {
+            std::cout << "Batch " << batch << ": " << occupancy.ofBatch(batch) << " students\n";
+        }
+
+        Footprint usage = measureFootprint();
+        std::cout << "Memory Footprint: " << usage.totalBytes() << " bytes\n";
+        for (int part = 0; part < Footprint::PartCount; part++) {
+            std::cout << "  " << Footprint::name(part) << ": " << usage.objects[part] << " objects, "
+                << usage.bytes[part] << " bytes\n";
+        }
+        std::cout << "\n";
     }
 
-    // Validate integrity (debug function)
-    void validateIntegrity() {
+    // Memory held by the system, by kind of storage
+    Footprint footprint() {
+        ReadGuard guard(this);
+        return measureFootprint();
+    }
+
+    // Students of a batch (only those taking 'subject', if given), in roll order
+    RecordSpan studentsOfBatch(int batchID, const char* subject = nullptr) {
+        unshareAll();
+        ReadGuard guard(this);
+        const StudentList* list = subject ?
+            students.group(batchID, subjects.find(subject)) : students.batch(batchID);
+        int from = 0;
+        int to = list ? list->size() : 0;
+        return mergeRecords(&list, &from, &to, list ? 1 : 0);
+    }
+
+    // Students taking a subject, across all batches, in roll order
+    RecordSpan studentsOfSubject(const char* subject) {
+        unshareAll();
+        ReadGuard guard(this);
+        int subjectId = subjects.find(subject);
+        const StudentList* lists[kBatchCount];
+        int from[kBatchCount];
+        int to[kBatchCount];
+        int listCount = 0;
+        for (int batch = kFirstBatch; batch < kFirstBatch + kBatchCount; batch++) {
+            const StudentList* list = students.group(batch, subjectId);
+            if (!list) continue;
+            lists[listCount] = list;
+            from[listCount] = 0;
+            to[listCount] = list->size();
+            listCount++;
+        }
+        return mergeRecords(lists, from, to, listCount);
+    }
+
+    // Students with rolls in [firstRoll, lastRoll], in roll order
+    RecordSpan studentsInRollRange(int firstRoll, int lastRoll) {
+        unshareAll();
+        ReadGuard guard(this);
+        const StudentList* lists[2];
+        int from[2];
+        int to[2];
+        for (int parity = 0; parity < 2; parity++) {
+            lists[parity] = &students.lane(parity);
+            from[parity] = lists[parity]->lowerBound(firstRoll);
+            to[parity] = firstRoll <= lastRoll ? lists[parity]->upperBound(lastRoll) : from[parity];
+        }
+        return mergeRecords(lists, from, to, 2);
+    }
+
+    // Print the rows of an index query
+    void printRecords(const RecordSpan& records) {
+        ReadGuard guard(this);
+        for (const StudentRecord& record : records) {
+            std::cout << "Roll " << record.rollNumber << " | Batch " << record.batchID
+                << " | " << subjects.name(record.subjectId)
+                << " | Block " << record.blockID << ", Floor " << record.floorNumber
+                << ", Room " << record.roomNumber << ", Row " << record.row
+                << ", Col " << record.col << "\n";
+        }
+        std::cout << records.size() << " students.\n";
+    }
+
+    // How many more students of 'batchID' taking 'subject' can be seated,
+    // assuming each lands in a vacancy of its lane (as ascending rolls do).
+    // Computed from lane free counts and the subject restriction, without
+    // touching any seat. If 'perRoom' is given it receives the count of every
+    // room in traversal order (countRooms() entries).
+    int capacityFor(int batchID, const char* subject, int* perRoom = nullptr) {
+        ReadGuard guard(this);
+        if (batchID < 22 || batchID > 25) {
+            std::cout << "Invalid batch ID! Must be 22-25.\n";
+            return 0;
+        }
+
+        return buildingCapacityFor(batchID, subjects.find(subject), perRoom);
+    }
+
+    // Rooms in the building
+    int countRooms() {
+        ReadGuard guard(this);
+        return roomCount;
+    }
+
+    // Print capacityFor room by room
+    void printCapacity(int batchID, const char* subject) {
+        ReadGuard guard(this);
+        if (batchID < 22 || batchID > 25) {
+            std::cout << "Invalid batch ID! Must be 22-25.\n";
+            return;
+        }
+
+        int* perRoom = new int[roomCount];
+        int total = buildingCapacityFor(batchID, subjects.find(subject), perRoom);
+
+        std::cout << "\n=== Capacity for Batch " << batchID << " - " << subject << " ===\n";
+        for (int i = 0; i < roomCount; i++) {
+            if (perRoom[i] == 0) continue;
+            Room* room = rooms[i];
+            std::cout << "Block " << room->floor->block->blockID.c_str() << " - Floor "
+                << room->floor->floorNumber << " - Room " << room->roomNumber
+                << ": " << perRoom[i] << " seats\n";
+        }
+        std::cout << "Total: " << total << " more students\n\n";
+        delete[] perRoom;
+    }
+
+    // Students of one batch across the building
+    int countBatch(int batchID) {
+        ReadGuard guard(this);
+        return occupancy.ofBatch(batchID);
+    }
+
+    // Validate integrity in one pass over the seats, block by block on the
+    // shared pool unless 'parallel' is false, then across blocks: system
+    // counts, unique rolls and the student index. Returns the number of
+    // errors. Roll order and the subject limit are placement preferences
+    // rather than invariants (a roll takes the first allowed vacancy, and a
+    // displaced student is not re-checked), so by default their violations
+    // are only reported as counts; with 'strict' each one is also an error.
+    int validateIntegrity(bool parallel = true, bool strict = false) {
+        ReadGuard guard(this);
         std::cout << "\n=== Validating System Integrity ===\n";
+        IntegrityTally* tallies = new IntegrityTally[totalBlocks];
+        TextStream report;
+        auto check = [&](int i, std::ostream& out) {
+            checkBlockIntegrity(blocks[i], out, tallies[i]);
+        };
+        if (parallel) {
+            writeBlocksInOrder(report, check);
+        }
+        else {
+            for (int i = 0; i < totalBlocks; i++) check(i, report);
+        }
+        report.writeTo(std::cout);
+
         int errors = 0;
+        int seated = 0;
+        int indexed = 0;
+        int inversions = 0;
+        int crowded = 0;
+        int lastRoll[2] = { kVacantRoll, kVacantRoll };
+        for (int i = 0; i < totalBlocks; i++) {
+            const IntegrityTally& tally = tallies[i];
+            errors += tally.errors;
+            seated += tally.seated;
+            indexed += tally.indexed;
+            inversions += tally.inversions;
+            crowded += tally.crowded;
+            for (int p = 0; p < 2; p++) {
+                if (tally.firstRoll[p] == kVacantRoll) continue;
+                if (tally.firstRoll[p] < lastRoll[p]) inversions++;
+                lastRoll[p] = tally.lastRoll[p];
+            }
+        }
+        delete[] tallies;
 
-        Block* block = firstBlock;
-        while (block) {
-            if (block->next && block->next->prev != block) {
-                std::cout << "Error: Block linkage broken!\n";
+        int blockSeats[kBatchCount] = {};
+        for (int i = 0; i < totalBlocks; i++) {
+            for (int b = 0; b < kBatchCount; b++) blockSeats[b] += blocks[i]->occupancy.batchSeats[b];
+        }
+        for (int b = 0; b < kBatchCount; b++) {
+            if (occupancy.batchSeats[b] != blockSeats[b]) {
+                std::cout << "Error: System counts " << occupancy.batchSeats[b] << " students of batch "
+                    << kFirstBatch + b << ", blocks hold " << blockSeats[b] << "!\n";
                 errors++;
             }
+        }
 
-            Floor* floor = block->firstFloor;
-            while (floor) {
-                if (floor->next && floor->next->prev != floor) {
-                    std::cout << "Error: Floor linkage broken!\n";
+        // Each roll once
+        RollMap seen(seated);
+        for (int i = 0; i < roomCount; i++) {
+            if (!rooms[i]->grid) continue;
+            for (int k = 0; k < rooms[i]->capacity(); k++) {
+                Student* student = rooms[i]->grid[k].student;
+                if (!student) continue;
+                int roll = student->rollNumber;
+                int times = seen.get(roll);
+                if (times == 1) {
+                    std::cout << "Error: Roll " << roll << " is seated more than once!\n";
                     errors++;
                 }
+                seen.put(roll, times < 0 ? 1 : times + 1);
+            }
+        }
 
-                Room* room = floor->firstRoom;
-                while (room) {
-                    if (room->next && room->next->prev != room) {
-                        std::cout << "Error: Room linkage broken!\n";
-                        errors++;
-                    }
-
-                    // Check seat connections
-                    for (int r = 0; r < gridSize; r++) {
-                        for (int c = 0; c < gridSize; c++) {
-                            Seat* seat = room->getSeat(r, c);
-                            if (!seat) {
-                                std::cout << "Error: Missing seat at (" << r << "," << c << ")\n";
-                                errors++;
-                            }
-                        }
-                    }
-
-                    room = room->next;
+        // Every indexed student sits where the index says
+        int listed = students.lane(0).size() + students.lane(1).size();
+        if (listed != indexed) {
+            std::cout << "Error: Student index holds " << listed << " students, seats hold "
+                << indexed << "!\n";
+            errors++;
+        }
+        for (int p = 0; p < 2; p++) {
+            const StudentList& lane = students.lane(p);
+            for (int k = 0; k < lane.size(); k++) {
+                Student* student = lane.at(k);
+                if (!student->seat || student->seat->student != student) {
+                    std::cout << "Error: Indexed roll " << student->rollNumber
+                        << " is not in its seat!\n";
+                    errors++;
                 }
-                floor = floor->next;
             }
-            block = block->next;
         }
 
+        if (inversions > 0) {
+            std::cout << (strict ? "Error: Roll order: " : "Roll order: ") << inversions
+                << " students seated after a larger roll of their lane\n";
+        }
+        if (crowded > 0) {
+            std::cout << (strict ? "Error: Subject limit: " : "Subject limit: ") << crowded
+                << " rooms where a batch past half its lane mixes subjects\n";
+        }
+        if (strict) errors += inversions + crowded;
         if (errors == 0) {
             std::cout << "System integrity: OK\n";
         }
@@ -1283,6 +5864,18 @@ public:
             std::cout << "Total errors found: " << errors << "\n";
         }
         std::cout << "\n";
+        return errors;
     }
 };
 
+// ============ Grid-size Aliases ============
+// Runtime-sized types, as used throughout the assignment.
+typedef BasicRoom<kDynamicGrid> Room;
+typedef BasicFloor<kDynamicGrid> Floor;
+typedef BasicBlock<kDynamicGrid> Block;
+typedef BasicSeatingSystem<kDynamicGrid> SeatingSystem;
+
+// Compile-time sized variants, e.g. FixedSeatingSystem<4> for the default grid.
+template <int N> using FixedRoom = BasicRoom<N>;
+template <int N> using FixedSeatingSystem = BasicSeatingSystem<N>;
+